@@ -201,4 +201,23 @@ void print_throughput(const ThroughputStats& stats) {
     std::cout << "=========================================\n";
 }
 
+/**
+ * @brief Print how a primitive's average latency changed against another build configuration
+ *
+ * A negative delta means the current configuration is faster.
+ *
+ * @param stats Statistics measured with the current configuration
+ * @param other Statistics of the same primitive measured with the other configuration
+ * @param other_name Name of the other configuration
+ */
+void print_delta(const PrimitiveStats& stats, const PrimitiveStats& other, const std::string& other_name) {
+    double delta_ns = stats.avg_ns - other.avg_ns;
+
+    std::cout << "\n=== " << stats.name << " vs " << other_name << " ===\n";
+    std::cout << "Average: " << stats.avg_ns << " ns\n";
+    std::cout << "Average (" << other_name << "): " << other.avg_ns << " ns\n";
+    std::cout << "Delta: " << delta_ns << " ns (" << (other.avg_ns ? 100.0 * delta_ns / other.avg_ns : 0.0) << "%)\n";
+    std::cout << "=========================================\n";
+}
+
 __END_SYS 
\ No newline at end of file
@@ -75,6 +75,15 @@ ThroughputStats calculate_throughput(const PrimitiveStats& latency_stats, size_t
  */
 void print_throughput(const ThroughputStats& stats);
 
+/**
+ * @brief Print how a primitive's average latency changed against another build configuration
+ *
+ * @param stats Statistics measured with the current configuration
+ * @param other Statistics of the same primitive measured with the other configuration
+ * @param other_name Name of the other configuration
+ */
+void print_delta(const PrimitiveStats& stats, const PrimitiveStats& other, const std::string& other_name);
+
 __END_SYS
 
 #endif 
\ No newline at end of file
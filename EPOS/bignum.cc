@@ -5,34 +5,100 @@
 __BEGIN_UTIL
 
 // Class attributes
+// Barrett's constant depends on the base (2^BITS_PER_DIGIT) and thus on the limb width:
+// barrett_u = floor(base^(2 * DIGITS) / _mod)
+
+// 32-bit limbs
+
+// 2^128 - 2^97 - 1: secp128r1, used by Diffie-Hellman
+template<>
+const Bignum<16, Bignum_Limb<32>>::_Word Bignum<16, Bignum_Limb<32>>::_mod = {{ 0xff, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0xfd, 0xff, 0xff, 0xff }};
+
 template<>
-const Bignum<16>::_Word Bignum<16>::_mod = {{ 0xff, 0xff, 0xff, 0xff,
-                                              0xff, 0xff, 0xff, 0xff,
-                                              0xff, 0xff, 0xff, 0xff,
-                                              0xfd, 0xff, 0xff, 0xff }};
+const Bignum<16, Bignum_Limb<32>>::_Barrett Bignum<16, Bignum_Limb<32>>::_barrett_u = {{ 17, 0, 0, 0,
+                                                                                          8, 0, 0, 0,
+                                                                                          4, 0, 0, 0,
+                                                                                          2, 0, 0, 0,
+                                                                                          1, 0, 0, 0}};
 
 template<>
-const Bignum<16>::_Barrett Bignum<16>::_barrett_u = {{ 17, 0, 0, 0,
-                                                        8, 0, 0, 0,
-                                                        4, 0, 0, 0,
-                                                        2, 0, 0, 0,
-                                                        1, 0, 0, 0}};
+const Bignum<16, Bignum_Limb<32>>::_Word Bignum<16, Bignum_Limb<32>>::_montgomery_r2 = {{ 0x11, 0x00, 0x00, 0x00,
+                                                                                         0x08, 0x00, 0x00, 0x00,
+                                                                                         0x04, 0x00, 0x00, 0x00,
+                                                                                         0x24, 0x00, 0x00, 0x00 }};
 
+template<>
+const Bignum<16, Bignum_Limb<32>>::Digit Bignum<16, Bignum_Limb<32>>::_montgomery_n0 = 1;
 
 // 2^(130) - 5: used by Poly1305
 template<>
-const Bignum<17>::_Word Bignum<17>::_mod = {{ 0xfb, 0xff, 0xff, 0xff,
-                                              0xff, 0xff, 0xff, 0xff,
-                                              0xff, 0xff, 0xff, 0xff,
-                                              0xff, 0xff, 0xff, 0xff,
-                                              0x03, 0x00, 0x00, 0x00 }};
+const Bignum<17, Bignum_Limb<32>>::_Word Bignum<17, Bignum_Limb<32>>::_mod = {{ 0xfb, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0x03, 0x00, 0x00, 0x00 }};
 
 // 0x400000000000000000000000000000005000000000000000
 template<>
-const Bignum<17>::_Barrett Bignum<17>::_barrett_u = {{ 0x00, 0x00, 0x00, 0x00,
-                                                       0x00, 0x00, 0x00, 0x50,
-                                                       0x00, 0x00, 0x00, 0x00,
-                                                       0x00, 0x00, 0x00, 0x00,
-                                                       0x00, 0x00, 0x00, 0x00,
-                                                       0x00, 0x00, 0x00, 0x40 }};
+const Bignum<17, Bignum_Limb<32>>::_Barrett Bignum<17, Bignum_Limb<32>>::_barrett_u = {{ 0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x50,
+                                                                                         0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x40 }};
+
+#ifdef __SIZEOF_INT128__
+
+// 64-bit limbs
+
+// 2^128 - 2^97 - 1: secp128r1, used by Diffie-Hellman
+template<>
+const Bignum<16, Bignum_Limb<64>>::_Word Bignum<16, Bignum_Limb<64>>::_mod = {{ 0xff, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0xfd, 0xff, 0xff, 0xff }};
+
+// Same as with 32-bit limbs, since base^(2 * DIGITS) = 2^256 in both cases
+template<>
+const Bignum<16, Bignum_Limb<64>>::_Barrett Bignum<16, Bignum_Limb<64>>::_barrett_u = {{ 17, 0, 0, 0,
+                                                                                          8, 0, 0, 0,
+                                                                                          4, 0, 0, 0,
+                                                                                          2, 0, 0, 0,
+                                                                                          1, 0, 0, 0,
+                                                                                          0, 0, 0, 0}};
+
+template<>
+const Bignum<16, Bignum_Limb<64>>::_Word Bignum<16, Bignum_Limb<64>>::_montgomery_r2 = {{ 0x11, 0x00, 0x00, 0x00,
+                                                                                         0x08, 0x00, 0x00, 0x00,
+                                                                                         0x04, 0x00, 0x00, 0x00,
+                                                                                         0x24, 0x00, 0x00, 0x00 }};
+
+template<>
+const Bignum<16, Bignum_Limb<64>>::Digit Bignum<16, Bignum_Limb<64>>::_montgomery_n0 = 1;
+
+// 2^(130) - 5: used by Poly1305
+template<>
+const Bignum<17, Bignum_Limb<64>>::_Word Bignum<17, Bignum_Limb<64>>::_mod = {{ 0xfb, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0xff, 0xff, 0xff, 0xff,
+                                                                                0x03, 0x00, 0x00, 0x00,
+                                                                                0x00, 0x00, 0x00, 0x00 }};
+
+// 0x4000000000000000000000000000000050000000000000000000000000000000
+template<>
+const Bignum<17, Bignum_Limb<64>>::_Barrett Bignum<17, Bignum_Limb<64>>::_barrett_u = {{ 0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x50,
+                                                                                         0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x00,
+                                                                                         0x00, 0x00, 0x00, 0x40 }};
+
+#endif
+
 __END_UTIL
@@ -4,6 +4,7 @@
 #define __bignum_h
 
 #include "epos_common.h"
+#include "random.h"
 
 __BEGIN_SYS
 class Poly1305;
@@ -11,16 +12,45 @@ __END_SYS
 
 __BEGIN_UTIL
 
+template<unsigned int SIZE> struct Bignum_Reduction;
+
+// Limb (digit) width policies for Bignum
+// Double_Digit must hold the product of two Digits
+template<unsigned int BITS> struct Bignum_Limb;
+
+template<>
+struct Bignum_Limb<32>
+{
+    typedef unsigned int Digit;
+    typedef unsigned long long Double_Digit;
+};
+
+// 64-bit limbs halve the number of digits and quarter the partial products of a multiplication,
+// but need a 128-bit type for the products, which compilers only provide on 64-bit hosts
+#ifdef __SIZEOF_INT128__
+template<>
+struct Bignum_Limb<64>
+{
+    typedef unsigned long long Digit;
+    typedef unsigned __int128 Double_Digit;
+};
+
+typedef Bignum_Limb<64> Default_Bignum_Limb;
+#else
+typedef Bignum_Limb<32> Default_Bignum_Limb;
+#endif
+
 // This class implements a prime finite field (Fp or GF(p))
 // It basically consists of (possibly) big numbers between 0 and a prime modulo, with + - * / operators
 // Primarily meant to be used primarily by asymmetric cryptography (e.g. Diffie-Hellman)
-template<unsigned int SIZE>
+template<unsigned int SIZE, typename Limb = Default_Bignum_Limb>
 class Bignum
 {
     friend class _SYS::Poly1305;
+    friend struct Bignum_Reduction<SIZE>;
 public:
-    typedef unsigned int Digit;
-    typedef unsigned long long Double_Digit;
+    typedef typename Limb::Digit Digit;
+    typedef typename Limb::Double_Digit Double_Digit;
 
     static const unsigned int DIGITS = (SIZE + sizeof(Digit) - 1) / sizeof(Digit);
     static const unsigned int BITS_PER_DIGIT = sizeof(Digit) * 8;
@@ -28,7 +58,7 @@ public:
     typedef Digit Word[DIGITS];
     typedef Double_Digit Double_Word[DIGITS];
 
-private:
+protected:
     union _Word {
         unsigned char bytes[sizeof(Word)];
         Digit data[sizeof(Word) / sizeof(Digit)];
@@ -39,14 +69,14 @@ private:
     };
 
 public:
-    Bignum(unsigned int n = 0) __attribute__((noinline)) {
+    Bignum(unsigned int n = 0) __DEBUG_NOINLINE {
         *this = n;
     }
     Bignum(const void * bytes, unsigned int len) {
         for(unsigned int i = 0, j = 0; i < DIGITS; i++) {
             _data[i] = 0;
             for(unsigned int k = 0; k < sizeof(Digit) && j < len; k++, j++)
-                _data[i] += (reinterpret_cast<const unsigned char *>(bytes)[j] << (8 * k));
+                _data[i] += (Digit(reinterpret_cast<const unsigned char *>(bytes)[j]) << (8 * k));
         }
     }
 
@@ -81,6 +111,13 @@ public:
             _data[i] = b._data[i];
     }
 
+    // _data = condition ? b._data : _data, without branching on condition
+    void conditional_assign(const Bignum & b, bool condition) {
+        Digit mask = -Digit(condition);
+        for(unsigned int i = 0; i < DIGITS; i++)
+            _data[i] = (_data[i] & ~mask) | (b._data[i] & mask);
+    }
+
     const Digit& operator[](unsigned int i) const { return _data[i]; }
 
     bool operator==(const Bignum & b) const { return (cmp(_data, b._data, DIGITS) == 0); }
@@ -90,7 +127,7 @@ public:
     bool  operator>(const Bignum & b) const { return (cmp(_data, b._data, DIGITS) > 0); }
     bool  operator<(const Bignum & b) const { return (cmp(_data, b._data, DIGITS) < 0); }
 
-    void operator*=(const Bignum & b) __attribute__((noinline)) { // _data = (_data * b._data) % _mod
+    void operator*=(const Bignum & b) __DEBUG_NOINLINE { // _data = (_data * b._data) % _mod
         if(b == 1) return;
 
         if(Traits<Bignum>::hysterically_debugged) {
@@ -102,13 +139,25 @@ public:
 
         Digit mult_result[2 * DIGITS];
         simple_mult(mult_result, _data, b._data, DIGITS);
-        barrett_reduction(_data, mult_result, DIGITS);
+        Bignum_Reduction<SIZE>::reduce(*this, mult_result);
 
         if(Traits<Bignum>::hysterically_debugged)
             db<Bignum>(TRC) << *this << std::endl;
     }
 
-    void operator+=(const Bignum &b)__attribute__((noinline)) { // _data = (_data + b._data) % _mod
+    void square() { // _data = (_data * _data) % _mod
+        if(Traits<Bignum>::hysterically_debugged)
+            db<Bignum>(TRC) << "Bignum::square(this=" << *this << ") => ";
+
+        Digit mult_result[2 * DIGITS];
+        simple_square(mult_result, _data, DIGITS);
+        Bignum_Reduction<SIZE>::reduce(*this, mult_result);
+
+        if(Traits<Bignum>::hysterically_debugged)
+            db<Bignum>(TRC) << *this << std::endl;
+    }
+
+    void operator+=(const Bignum &b) __DEBUG_NOINLINE { // _data = (_data + b._data) % _mod
         if(Traits<Bignum>::hysterically_debugged) {
             db<Bignum>(TRC) << "Bignum::operator+=(this=" << *this << ",other=" << b << ",mod=[";
             for(unsigned int i = 0; i < DIGITS - 1; i++)
@@ -125,7 +174,7 @@ public:
             db<Bignum>(TRC) << *this << std::endl;
     }
 
-    void operator-=(const Bignum &b)__attribute__((noinline)) { // _data = (_data - b._data) % _mod
+    void operator-=(const Bignum &b) __DEBUG_NOINLINE { // _data = (_data - b._data) % _mod
         if(Traits<Bignum>::hysterically_debugged) {
             db<Bignum>(TRC) << "Bignum::operator-=(this=" << *this << ",other=" << b << ",mod=[";
             for(unsigned int i = 0; i < DIGITS - 1; i++)
@@ -143,7 +192,7 @@ public:
     // Shift left (actually shift right, because of little endianness)
     // - Does not apply modulo
     // - Returns carry bit
-    bool multiply_by_two(bool carry = 0) __attribute__((noinline))
+    bool multiply_by_two(bool carry = 0) __DEBUG_NOINLINE
     {
         if(Traits<Bignum>::hysterically_debugged && !carry) {
             db<Bignum>(TRC) << "Bignum::multiply_by_two(this=" << *this << ",mod=[";
@@ -169,7 +218,7 @@ public:
     // Shift right (actually shift left, because of little endianness)
     // - Does not apply modulo
     // - Returns carry bit
-    bool divide_by_two(bool carry = 0) __attribute__((noinline))
+    bool divide_by_two(bool carry = 0) __DEBUG_NOINLINE
     {
         if(Traits<Bignum>::hysterically_debugged && !carry) {
             db<Bignum>(TRC) << "Bignum::divide_by_two(this=" << *this << ",mod=[";
@@ -192,16 +241,15 @@ public:
         return carry;
     }
 
-    void randomize() __attribute__((noinline)) { // Sets _data to a random number smaller than _mod
+    void randomize() __DEBUG_NOINLINE { // Sets _data to a random number smaller than _mod
         int i;
         for(i = DIGITS - 1; i >= 0 && (_mod.data[i] == 0); i--)
             _data[i]=0;
-        _data[i] = Random::random() % _mod.data[i];
-        for(--i; i >= 0; i--)
-            _data[i] = Random::random();
+        _SYS::Random::fill(_data, (i + 1) * sizeof(Digit));
+        _data[i] %= _mod.data[i];
     }
 
-    void invert() __attribute__((noinline)) { // _data = i, such that (_data * i) % _mod = 1
+    void invert() __DEBUG_NOINLINE { // _data = i, such that (_data * i) % _mod = 1
         Bignum A(1), u, v, zero(0);
         for(unsigned int i = 0; i < DIGITS; i++) {
             u._data[i] = _data[i];
@@ -241,7 +289,7 @@ public:
         unsigned int i;
         out << '[';
         for(i = 0; i < DIGITS; i++) {
-            out << (unsigned int)b._data[i];
+            out << b._data[i];
             if(i < DIGITS - 1)
                 out << ", ";
         }
@@ -249,7 +297,7 @@ public:
         return out;
     }
 
-private:
+protected:
     static int cmp(const Digit * a, const Digit * b, int size) { // a == b -> 0, a > b -> 1, a < b -> -1
         for(int i = size - 1; i >= 0; i--) {
             if(a[i] > b[i]) return 1;
@@ -263,7 +311,7 @@ private:
     // -No modulo applied
     // -a, b and res are assumed to have size 'size'
     // -a, b, res are allowed to point to the same place
-    static bool simple_sub(Digit * res, const Digit * a, const Digit * b, unsigned int size) __attribute__((noinline)) {
+    static bool simple_sub(Digit * res, const Digit * a, const Digit * b, unsigned int size) __DEBUG_NOINLINE {
         Double_Digit borrow = 0;
         Double_Digit aux = Double_Digit(1) << BITS_PER_DIGIT;
         for(unsigned int i = 0; i < size; i++) {
@@ -280,7 +328,7 @@ private:
     // -No modulo applied
     // -a, b and res are assumed to have size 'size'
     // -a, b, res are allowed to point to the same place
-    static bool simple_add(Digit * res, const Digit * a, const Digit * b, unsigned int size) __attribute__((noinline)) {
+    static bool simple_add(Digit * res, const Digit * a, const Digit * b, unsigned int size) __DEBUG_NOINLINE {
         bool carry = 0;
         for(unsigned int i = 0; i < size; i++) {
             Double_Digit tmp = Double_Digit(carry) + Double_Digit(a[i]) + Double_Digit(b[i]);
@@ -319,6 +367,47 @@ private:
         res[i] = r0;
     }
 
+    // res = (a * a)
+    // - Same as simple_mult(res, a, a, size), but each cross product a[j] * a[k] (j != k) is computed once and doubled
+    // - res is assumed to be of size '2*size'
+    static void simple_square(Digit * res, const Digit * a, unsigned int size) {
+        // Cross products a[j] * a[k], j < k, row by row
+        Double_Digit carry = 0;
+        res[0] = 0;
+        for(unsigned int k = 1; k < size; k++) {
+            carry += Double_Digit(a[0]) * a[k];
+            res[k] = Digit(carry);
+            carry >>= BITS_PER_DIGIT;
+        }
+        res[size] = carry;
+        for(unsigned int j = 1; j < size; j++) {
+            carry = 0;
+            for(unsigned int k = j + 1; k < size; k++) {
+                carry += Double_Digit(a[j]) * a[k] + res[j + k];
+                res[j + k] = Digit(carry);
+                carry >>= BITS_PER_DIGIT;
+            }
+            res[j + size] = carry;
+        }
+
+        // Double them and add the squares a[j] * a[j]
+        Digit shifted = 0;
+        carry = 0;
+        for(unsigned int j = 0; j < size; j++) {
+            Digit lo = res[2 * j];
+            Digit hi = res[2 * j + 1];
+            Double_Digit square = Double_Digit(a[j]) * a[j];
+
+            carry += Digit(square) + Double_Digit(Digit(lo << 1) | shifted);
+            res[2 * j] = carry;
+            carry >>= BITS_PER_DIGIT;
+            carry += (square >> BITS_PER_DIGIT) + Double_Digit(Digit(hi << 1) | (lo >> (BITS_PER_DIGIT - 1)));
+            res[2 * j + 1] = carry;
+            carry >>= BITS_PER_DIGIT;
+            shifted = hi >> (BITS_PER_DIGIT - 1);
+        }
+    }
+
     // res = a % _mod
     // - Intended to be used after a multiplication
     // - res is assumed to be of size 'size'
@@ -388,11 +477,199 @@ private:
             res[i] = r[i];
     }
 
-private:
+    // res = a % _mod, for _mod = 2^k - (2^c0 + 2^c1) (pseudo-Mersenne)
+    // - Folds the bits above k back into the number, since 2^k % _mod = 2^c0 + 2^c1, using only shifts and adds
+    // - res is assumed to be of size 'size'
+    // - a is assumed to be of size '2*size'
+    static void pseudo_mersenne_reduction(Digit * res, const Digit * a, unsigned int size, unsigned int k, unsigned int c0, unsigned int c1) {
+        const unsigned int kw = k / BITS_PER_DIGIT;
+        const unsigned int kb = k % BITS_PER_DIGIT;
+
+        Digit r[2 * DIGITS];
+        Digit hi[2 * DIGITS];
+        for(unsigned int i = 0; i < 2 * size; i++)
+            r[i] = a[i];
+
+        while(true) {
+            // hi = r / 2^k
+            Digit any = 0;
+            for(unsigned int i = 0; i < 2 * size - kw; i++) {
+                hi[i] = r[kw + i] >> kb;
+                if(kb && (kw + i + 1 < 2 * size))
+                    hi[i] |= r[kw + i + 1] << (BITS_PER_DIGIT - kb);
+                any |= hi[i];
+            }
+            if(!any)
+                break;
+
+            // r = r % 2^k + hi * 2^c0 + hi * 2^c1
+            r[kw] &= (Digit(1) << kb) - 1;
+            for(unsigned int i = kw + 1; i < 2 * size; i++)
+                r[i] = 0;
+            shifted_add(r, 2 * size, hi, 2 * size - kw, c0);
+            shifted_add(r, 2 * size, hi, 2 * size - kw, c1);
+        }
+
+        // r < 2^k < 2 * _mod
+        if(cmp(r, _mod.data, size) >= 0)
+            simple_sub(r, r, _mod.data, size);
+
+        for(unsigned int i = 0; i < size; i++)
+            res[i] = r[i];
+    }
+
+    // res = res + (a << shift)
+    // - No modulo applied
+    // - Carries beyond res_size are dropped
+    static void shifted_add(Digit * res, unsigned int res_size, const Digit * a, unsigned int a_size, unsigned int shift) {
+        const unsigned int w = shift / BITS_PER_DIGIT;
+        const unsigned int b = shift % BITS_PER_DIGIT;
+
+        Double_Digit carry = 0;
+        for(unsigned int i = 0; i + w < res_size; i++) {
+            Digit d = (i < a_size) ? (a[i] << b) : 0;
+            if(b && (i > 0) && (i - 1 < a_size))
+                d |= a[i - 1] >> (BITS_PER_DIGIT - b);
+            carry += Double_Digit(res[i + w]) + d;
+            res[i + w] = carry;
+            carry >>= BITS_PER_DIGIT;
+        }
+    }
+
+    // res = (a * R^-1) % _mod, with R = base^size (Montgomery's REDC)
+    // - Intended to be used after a multiplication of two numbers in Montgomery form
+    // - res is assumed to be of size 'size'
+    // - a is assumed to be of size '2*size'
+    static void montgomery_reduction(Digit * res, const Digit * a, unsigned int size) {
+        Digit t[2 * DIGITS + 1];
+        for(unsigned int i = 0; i < 2 * size; i++)
+            t[i] = a[i];
+        t[2 * size] = 0;
+
+        // t = t + m * _mod * base^i, with m chosen to zero t[i]
+        for(unsigned int i = 0; i < size; i++) {
+            Digit m = t[i] * _montgomery_n0;
+            Double_Digit carry = 0;
+            unsigned int j;
+            for(j = 0; j < size; j++) {
+                carry += Double_Digit(m) * _mod.data[j] + t[i + j];
+                t[i + j] = carry;
+                carry >>= BITS_PER_DIGIT;
+            }
+            for(j += i; carry && (j <= 2 * size); j++) {
+                carry += t[j];
+                t[j] = carry;
+                carry >>= BITS_PER_DIGIT;
+            }
+        }
+
+        // t / base^size < 2 * _mod
+        if(t[2 * size] || (cmp(&t[size], _mod.data, size) >= 0))
+            simple_sub(&t[size], &t[size], _mod.data, size);
+
+        for(unsigned int i = 0; i < size; i++)
+            res[i] = t[size + i];
+    }
+
+protected:
     Word _data;
 
     static const _Word _mod;
     static const _Barrett _barrett_u;
+    static const _Word _montgomery_r2; // R^2 % _mod
+    static const Digit _montgomery_n0; // -(_mod^-1) % base
+};
+
+
+// Reduction after a multiplication, selected by specialization on the size of the modulus
+// The generic version applies Barrett's reduction, while the specializations exploit the pseudo-Mersenne
+// form of the moduli defined in bignum.cc
+template<unsigned int SIZE>
+struct Bignum_Reduction
+{
+    template<typename B>
+    static void reduce(B & b, const typename B::Digit * a) { b.barrett_reduction(b._data, a, B::DIGITS); }
+};
+
+// 2^128 - 2^97 - 1: secp128r1 (Diffie-Hellman)
+template<>
+struct Bignum_Reduction<16>
+{
+    template<typename B>
+    static void reduce(B & b, const typename B::Digit * a) { B::pseudo_mersenne_reduction(b._data, a, B::DIGITS, 128, 0, 97); }
+};
+
+// 2^130 - 5: Poly1305
+template<>
+struct Bignum_Reduction<17>
+{
+    template<typename B>
+    static void reduce(B & b, const typename B::Digit * a) { B::pseudo_mersenne_reduction(b._data, a, B::DIGITS, 130, 0, 2); }
+};
+
+
+// Element of the same prime field as Bignum kept in Montgomery form (a * R % _mod, with R = base^DIGITS)
+// Additions and subtractions are the same as Bignum's, while multiplications replace Barrett's
+// quotient estimation with Montgomery's reduction. Entering and leaving the representation costs
+// one multiplication each, so it pays off for long chains of multiplications (e.g. ECC point multiplication)
+template<unsigned int SIZE, typename Limb = Default_Bignum_Limb>
+class Montgomery_Bignum: public Bignum<SIZE, Limb>
+{
+    typedef Bignum<SIZE, Limb> Base;
+
+    using Base::DIGITS;
+    using Base::_data;
+    using Base::_montgomery_r2;
+
+public:
+    typedef typename Base::Digit Digit;
+
+public:
+    Montgomery_Bignum(unsigned int n = 0): Base(n) { if(n) to_montgomery(); }
+    explicit Montgomery_Bignum(const Base & b): Base(b) { to_montgomery(); }
+
+    void operator=(unsigned int n) {
+        Base::operator=(n);
+        if(n)
+            to_montgomery();
+    }
+
+    void operator*=(const Montgomery_Bignum & b) { // _data = (_data * b._data * R^-1) % _mod
+        if(Traits<Base>::hysterically_debugged)
+            db<Base>(TRC) << "Montgomery_Bignum::operator*=(this=" << *this << ",other=" << b << ") => ";
+
+        Digit mult_result[2 * DIGITS];
+        Base::simple_mult(mult_result, _data, b._data, DIGITS);
+        Base::montgomery_reduction(_data, mult_result, DIGITS);
+
+        if(Traits<Base>::hysterically_debugged)
+            db<Base>(TRC) << *this << std::endl;
+    }
+
+    void square() { // _data = (_data * _data * R^-1) % _mod
+        Digit mult_result[2 * DIGITS];
+        Base::simple_square(mult_result, _data, DIGITS);
+        Base::montgomery_reduction(_data, mult_result, DIGITS);
+    }
+
+    // Leaves Montgomery form
+    Base bignum() const {
+        Digit mult_result[2 * DIGITS];
+        for(unsigned int i = 0; i < DIGITS; i++) {
+            mult_result[i] = _data[i];
+            mult_result[DIGITS + i] = 0;
+        }
+        Montgomery_Bignum b;
+        Base::montgomery_reduction(b._data, mult_result, DIGITS);
+        return b;
+    }
+
+private:
+    void to_montgomery() {
+        Digit mult_result[2 * DIGITS];
+        Base::simple_mult(mult_result, _data, _montgomery_r2.data, DIGITS);
+        Base::montgomery_reduction(_data, mult_result, DIGITS);
+    }
 };
 
 __END_UTIL
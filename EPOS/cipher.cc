@@ -0,0 +1,188 @@
+// EPOS Cipher Mediator Common Package Implementation
+
+#include "cipher.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <wmmintrin.h>
+#define __cipher_aes_ni
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define __cipher_armv8_ce
+#endif
+
+__BEGIN_SYS
+
+// Class methods
+bool AES_Instructions::detect()
+{
+#if defined(__cipher_aes_ni)
+    return __builtin_cpu_supports("aes");
+#elif defined(__cipher_armv8_ce)
+    return getauxval(AT_HWCAP) & HWCAP_AES;
+#else
+    return false;
+#endif
+}
+
+const char * AES_Instructions::name()
+{
+#if defined(__cipher_aes_ni)
+    return "AES-NI";
+#elif defined(__cipher_armv8_ce)
+    return "ARMv8 Crypto Extensions";
+#else
+    return "none";
+#endif
+}
+
+#if defined(__cipher_aes_ni)
+
+// AESENC takes several cycles to complete but a new one can start every cycle, so four independent blocks go
+// through each round together
+__attribute__((target("aes,sse2")))
+void AES_Instructions::encrypt(const unsigned char * round_keys, const unsigned char * input, unsigned char * output, unsigned int blocks)
+{
+    const __m128i * in = reinterpret_cast<const __m128i *>(input);
+    __m128i * out = reinterpret_cast<__m128i *>(output);
+    __m128i k[11];
+    for(unsigned int round = 0; round <= 10; round++)
+        k[round] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&round_keys[16 * round]));
+
+    unsigned int i = 0;
+    for(; i + 4 <= blocks; i += 4) {
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128(&in[i + 0]), k[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128(&in[i + 1]), k[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128(&in[i + 2]), k[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128(&in[i + 3]), k[0]);
+        for(unsigned int round = 1; round < 10; round++) {
+            b0 = _mm_aesenc_si128(b0, k[round]);
+            b1 = _mm_aesenc_si128(b1, k[round]);
+            b2 = _mm_aesenc_si128(b2, k[round]);
+            b3 = _mm_aesenc_si128(b3, k[round]);
+        }
+        _mm_storeu_si128(&out[i + 0], _mm_aesenclast_si128(b0, k[10]));
+        _mm_storeu_si128(&out[i + 1], _mm_aesenclast_si128(b1, k[10]));
+        _mm_storeu_si128(&out[i + 2], _mm_aesenclast_si128(b2, k[10]));
+        _mm_storeu_si128(&out[i + 3], _mm_aesenclast_si128(b3, k[10]));
+    }
+    for(; i < blocks; i++) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(&in[i]), k[0]);
+        for(unsigned int round = 1; round < 10; round++)
+            b = _mm_aesenc_si128(b, k[round]);
+        _mm_storeu_si128(&out[i], _mm_aesenclast_si128(b, k[10]));
+    }
+}
+
+__attribute__((target("aes,sse2")))
+void AES_Instructions::decrypt(const unsigned char * inverse_round_keys, const unsigned char * input, unsigned char * output, unsigned int blocks)
+{
+    const __m128i * in = reinterpret_cast<const __m128i *>(input);
+    __m128i * out = reinterpret_cast<__m128i *>(output);
+    __m128i k[11];
+    for(unsigned int round = 0; round <= 10; round++)
+        k[round] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&inverse_round_keys[16 * round]));
+
+    unsigned int i = 0;
+    for(; i + 4 <= blocks; i += 4) {
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128(&in[i + 0]), k[10]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128(&in[i + 1]), k[10]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128(&in[i + 2]), k[10]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128(&in[i + 3]), k[10]);
+        for(unsigned int round = 9; round > 0; round--) {
+            b0 = _mm_aesdec_si128(b0, k[round]);
+            b1 = _mm_aesdec_si128(b1, k[round]);
+            b2 = _mm_aesdec_si128(b2, k[round]);
+            b3 = _mm_aesdec_si128(b3, k[round]);
+        }
+        _mm_storeu_si128(&out[i + 0], _mm_aesdeclast_si128(b0, k[0]));
+        _mm_storeu_si128(&out[i + 1], _mm_aesdeclast_si128(b1, k[0]));
+        _mm_storeu_si128(&out[i + 2], _mm_aesdeclast_si128(b2, k[0]));
+        _mm_storeu_si128(&out[i + 3], _mm_aesdeclast_si128(b3, k[0]));
+    }
+    for(; i < blocks; i++) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(&in[i]), k[10]);
+        for(unsigned int round = 9; round > 0; round--)
+            b = _mm_aesdec_si128(b, k[round]);
+        _mm_storeu_si128(&out[i], _mm_aesdeclast_si128(b, k[0]));
+    }
+}
+
+#elif defined(__cipher_armv8_ce)
+
+// AESE and AESD add the round key before substituting and shifting, so the last key is added apart
+// Blocks are interleaved as with AES-NI (AESE/AESMC pairs also issue back to back on most cores)
+__attribute__((target("+crypto")))
+void AES_Instructions::encrypt(const unsigned char * round_keys, const unsigned char * input, unsigned char * output, unsigned int blocks)
+{
+    uint8x16_t k[11];
+    for(unsigned int round = 0; round <= 10; round++)
+        k[round] = vld1q_u8(&round_keys[16 * round]);
+
+    unsigned int i = 0;
+    for(; i + 4 <= blocks; i += 4) {
+        uint8x16_t b0 = vld1q_u8(&input[16 * (i + 0)]);
+        uint8x16_t b1 = vld1q_u8(&input[16 * (i + 1)]);
+        uint8x16_t b2 = vld1q_u8(&input[16 * (i + 2)]);
+        uint8x16_t b3 = vld1q_u8(&input[16 * (i + 3)]);
+        for(unsigned int round = 0; round < 9; round++) {
+            b0 = vaesmcq_u8(vaeseq_u8(b0, k[round]));
+            b1 = vaesmcq_u8(vaeseq_u8(b1, k[round]));
+            b2 = vaesmcq_u8(vaeseq_u8(b2, k[round]));
+            b3 = vaesmcq_u8(vaeseq_u8(b3, k[round]));
+        }
+        vst1q_u8(&output[16 * (i + 0)], veorq_u8(vaeseq_u8(b0, k[9]), k[10]));
+        vst1q_u8(&output[16 * (i + 1)], veorq_u8(vaeseq_u8(b1, k[9]), k[10]));
+        vst1q_u8(&output[16 * (i + 2)], veorq_u8(vaeseq_u8(b2, k[9]), k[10]));
+        vst1q_u8(&output[16 * (i + 3)], veorq_u8(vaeseq_u8(b3, k[9]), k[10]));
+    }
+    for(; i < blocks; i++) {
+        uint8x16_t b = vld1q_u8(&input[16 * i]);
+        for(unsigned int round = 0; round < 9; round++)
+            b = vaesmcq_u8(vaeseq_u8(b, k[round]));
+        vst1q_u8(&output[16 * i], veorq_u8(vaeseq_u8(b, k[9]), k[10]));
+    }
+}
+
+__attribute__((target("+crypto")))
+void AES_Instructions::decrypt(const unsigned char * inverse_round_keys, const unsigned char * input, unsigned char * output, unsigned int blocks)
+{
+    uint8x16_t k[11];
+    for(unsigned int round = 0; round <= 10; round++)
+        k[round] = vld1q_u8(&inverse_round_keys[16 * round]);
+
+    unsigned int i = 0;
+    for(; i + 4 <= blocks; i += 4) {
+        uint8x16_t b0 = vld1q_u8(&input[16 * (i + 0)]);
+        uint8x16_t b1 = vld1q_u8(&input[16 * (i + 1)]);
+        uint8x16_t b2 = vld1q_u8(&input[16 * (i + 2)]);
+        uint8x16_t b3 = vld1q_u8(&input[16 * (i + 3)]);
+        for(unsigned int round = 10; round > 1; round--) {
+            b0 = vaesimcq_u8(vaesdq_u8(b0, k[round]));
+            b1 = vaesimcq_u8(vaesdq_u8(b1, k[round]));
+            b2 = vaesimcq_u8(vaesdq_u8(b2, k[round]));
+            b3 = vaesimcq_u8(vaesdq_u8(b3, k[round]));
+        }
+        vst1q_u8(&output[16 * (i + 0)], veorq_u8(vaesdq_u8(b0, k[1]), k[0]));
+        vst1q_u8(&output[16 * (i + 1)], veorq_u8(vaesdq_u8(b1, k[1]), k[0]));
+        vst1q_u8(&output[16 * (i + 2)], veorq_u8(vaesdq_u8(b2, k[1]), k[0]));
+        vst1q_u8(&output[16 * (i + 3)], veorq_u8(vaesdq_u8(b3, k[1]), k[0]));
+    }
+    for(; i < blocks; i++) {
+        uint8x16_t b = vld1q_u8(&input[16 * i]);
+        for(unsigned int round = 10; round > 1; round--)
+            b = vaesimcq_u8(vaesdq_u8(b, k[round]));
+        vst1q_u8(&output[16 * i], veorq_u8(vaesdq_u8(b, k[1]), k[0]));
+    }
+}
+
+#else
+
+// Never called, since available() is false
+void AES_Instructions::encrypt(const unsigned char *, const unsigned char *, unsigned char *, unsigned int) {}
+void AES_Instructions::decrypt(const unsigned char *, const unsigned char *, unsigned char *, unsigned int) {}
+
+#endif
+
+__END_SYS
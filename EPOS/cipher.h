@@ -14,6 +14,7 @@ public:
 	enum Mode {
 		ECB,
 		CBC,
+		CTR,
 	};
 
 protected:
@@ -22,95 +23,203 @@ protected:
 
 
 
+// AES-128 round instructions of the CPU, detected at run time: AES-NI on x86, Crypto Extensions on aarch64
+class AES_Instructions
+{
+public:
+    static bool available() {
+        static const bool instructions = detect();
+        return instructions;
+    }
+    static const char * name();
+
+    // round_keys are the 11 FIPS-197 round keys; inverse_round_keys are those of the equivalent inverse cipher
+    // (inv_mix_columns applied to rounds 1 to 9). Consecutive blocks are interleaved four at a time.
+    static void encrypt(const unsigned char * round_keys, const unsigned char * input, unsigned char * output, unsigned int blocks = 1);
+    static void decrypt(const unsigned char * inverse_round_keys, const unsigned char * input, unsigned char * output, unsigned int blocks = 1);
+
+private:
+    static bool detect();
+};
+
+
 // EPOS 128-bit Advanced Encryption Standard (AES) Software Implementation
 // Adapted from https://github.com/kokke/tiny-AES128-C
-template <unsigned int KEY_LENGTH = 16>
+// ENGINE selects the round implementation (see Traits<Cipher>); HARDWARE lets AES_Instructions replace it when available
+template <unsigned int KEY_LENGTH = 16, unsigned int ENGINE = Traits<Cipher>::BYTE, bool HARDWARE = false>
 class Software_AES : public Cipher_Common
 {
 private:
-    static const unsigned int Nb = 4; // number of columns comprising a _state
+    static const unsigned int Nb = 4; // number of columns comprising a state
     static const unsigned int Nk = 4; // number of 32 bit words in a key
     static const int Nr = 10; // number of rounds in AES cipher
 
+    // Blocks CBC decryption and CTR hand to the round implementation at once (ECB hands all of them),
+    // so AES_Instructions can interleave their rounds
+    static const unsigned int PIPELINE = 8;
+
+    // Both T_TABLE and AES_Instructions decrypt with the equivalent inverse cipher
+    static const bool INVERSE_KEYS = (ENGINE == Traits<Cipher>::T_TABLE) || HARDWARE;
+
     typedef unsigned char State[4][4]; // array holding the intermediate results during decryption
 
 public:
     static const typename IF<KEY_LENGTH == 16, unsigned int, void>::Result KEY_SIZE = 16; // KEY_SIZE must be 16
 
+    // Round keys of a cipher key, expanded once and then passed to encrypt() and decrypt() for any number of blocks
+    // (only read by them, so one schedule per session key can be shared by several threads)
+    class Key_Schedule
+    {
+        friend class Software_AES;
+
+    public:
+        Key_Schedule(): _decryption(false) {}
+        explicit Key_Schedule(const unsigned char * key, bool decryption = true) { expand(key, decryption); }
+
+        // Schedules only used for encryption (e.g. by CTR-like constructions) can skip the decryption round keys
+        void expand(const unsigned char * key, bool decryption = true) {
+            expand_encryption(key);
+            _decryption = false;
+            if(decryption)
+                expand_decryption();
+        }
+
+    private:
+        void expand_encryption(const unsigned char * key);
+        void expand_decryption();
+
+    private:
+        unsigned char _round_key[Nb * (Nr + 1) * 4];
+        // T_TABLE decryption runs the equivalent inverse cipher, with inv_mix_columns applied to the inner round keys
+        unsigned char _inverse_round_key[INVERSE_KEYS ? Nb * (Nr + 1) * 4 : 1];
+        bool _decryption; // whether _inverse_round_key is up to date
+    };
+
 public:
     Software_AES(const Mode & m = ECB): _mode(m) {
-        assert((m == ECB) || (m == CBC));
-        for(unsigned int i = 0; i < 23; i++)
-            iv[i] = 0;
+        assert((m == ECB) || (m == CBC) || (m == CTR));
+        std::memset(_chain, 0, sizeof(_chain));
+    }
+
+    Mode mode() const { return _mode; }
+
+    static const char * backend() {
+        if(HARDWARE && AES_Instructions::available())
+            return AES_Instructions::name();
+        return (ENGINE == Traits<Cipher>::T_TABLE) ? "software (T-table)" : "software (byte-oriented)";
     }
 
-    Mode mode() { return _mode; }
+    // Single blocks: CBC and CTR start from an all-zero initialization vector (or counter) on every call
+
+    // With a raw key, each call expands it into this object (a null key reuses the round keys of the previous raw key)
+    void encrypt(const void * data, const unsigned char * key, unsigned char * result) { unsigned char iv[KEY_SIZE] = {}; crypt(data, KEY_SIZE, schedule(key, false), result, iv, true); }
+    void decrypt(const void * data, const unsigned char * key, unsigned char * result) { unsigned char iv[KEY_SIZE] = {}; crypt(data, KEY_SIZE, schedule(key, _mode != CTR), result, iv, false); }
+
+    // With a Key_Schedule, no expansion happens and nothing but result is written, so calls can run concurrently
+    void encrypt(const void * data, const Key_Schedule & key, unsigned char * result) const { unsigned char iv[KEY_SIZE] = {}; crypt(data, KEY_SIZE, key, result, iv, true); }
+    void decrypt(const void * data, const Key_Schedule & key, unsigned char * result) const { unsigned char iv[KEY_SIZE] = {}; crypt(data, KEY_SIZE, key, result, iv, false); }
+
+    // Bulk operation on length bytes, in place if result == data
+    // ECB and CBC take whole blocks; CTR takes any length (the counter still advances by whole blocks)
+    // iv is the CBC initialization vector or the initial CTR counter block (big-endian, incremented over all 128 bits)
+
+    // With a raw key, a null iv continues the chain (or the count) where the previous raw key bulk call stopped
+    void encrypt(const void * data, size_t length, const unsigned char * key, unsigned char * result, const unsigned char * iv = 0) {
+        const Key_Schedule & k = schedule(key, false);
+        if(iv != 0)
+            std::memcpy(_chain, iv, KEY_SIZE);
+        crypt(data, length, k, result, _chain, true);
+    }
+    void decrypt(const void * data, size_t length, const unsigned char * key, unsigned char * result, const unsigned char * iv = 0) {
+        const Key_Schedule & k = schedule(key, _mode != CTR);
+        if(iv != 0)
+            std::memcpy(_chain, iv, KEY_SIZE);
+        crypt(data, length, k, result, _chain, false);
+    }
 
-    void encrypt(const void * data, const unsigned char * key, unsigned char * result) { crypt(data, key, result, true); }
-    void decrypt(const void * data, const unsigned char * key, unsigned char * result) { crypt(data, key, result, false); }
+    // With a Key_Schedule, the caller keeps the chain: iv (unused by ECB) is updated to the last CBC ciphertext block
+    // or to the next CTR counter block, ready for a following call
+    void encrypt(const void * data, size_t length, const Key_Schedule & key, unsigned char * result, unsigned char * iv) const { crypt(data, length, key, result, iv, true); }
+    void decrypt(const void * data, size_t length, const Key_Schedule & key, unsigned char * result, unsigned char * iv) const { crypt(data, length, key, result, iv, false); }
+
+    // CCM* (IEEE 802.15.4-2006 Annex B, CCM of RFC 3610 with L = 2 plus encryption-only M = 0): authenticated encryption
+    // of payload in place, with header as associated data (authenticated only), in a single pass under one key schedule
+    // (encryption round keys only). Each CBC-MAC block goes through the rounds together with a CTR key stream block.
+    // nonce has CCM_NONCE_SIZE bytes and must never repeat under a key (802.15.4: source extended address,
+    // frame counter and security level); mic_size is 0, 4, 6, 8, 10, 12, 14 or 16 bytes.
+    static const unsigned int CCM_NONCE_SIZE = 13;
+
+    static void ccm_encrypt(const Key_Schedule & key, const unsigned char * nonce, const void * header, size_t header_size,
+                            unsigned char * payload, size_t payload_size, unsigned char * mic, unsigned int mic_size);
+    // Returns false, with payload zeroed, if mic does not authenticate header and payload
+    static bool ccm_decrypt(const Key_Schedule & key, const unsigned char * nonce, const void * header, size_t header_size,
+                            unsigned char * payload, size_t payload_size, const unsigned char * mic, unsigned int mic_size);
 
 private:
     void mode(const Mode & m) {
-        assert((m == ECB) || (m == CBC));
+        assert((m == ECB) || (m == CBC) || (m == CTR));
         _mode = m;
     }
 
-    void crypt(const void * _data, const unsigned char * key, unsigned char * result, bool encrypt)
-    {
-        const unsigned char * data = reinterpret_cast<const unsigned char *>(_data);
-
-        db<Software_AES>(TRC) << "Software_AES::" << (encrypt ? "en" : "de") << "crypt(data=" << _data << ",key=" << reinterpret_cast<const void*>(key) << ",result=" << reinterpret_cast<const void*>(result) << std::endl;
-        db<Software_AES>(INF) << "Software_AES::" << (encrypt ? "en" : "de") << "crypt:data = {" << int(data[0]);
-        for(unsigned int i = 1; i < 16; i++)
-            db<Software_AES>(INF) << "," << int(data[i]);
-        db<Software_AES>(INF) << "}" << std::endl;
-        db<Software_AES>(INF) << "Software_AES::" << (encrypt ? "en" : "de") << "crypt:key = {" << int(key[0]);
-        for(unsigned int i = 1; i < 16; i++)
-            db<Software_AES>(INF) << "," << int(key[i]);
-        db<Software_AES>(INF) << "}" << std::endl;
-
-        switch(_mode) {
-        case CBC:
-            if(encrypt)
-                aes128_cbc_encrypt_buffer(result, data, 16, key, iv);
-            else
-                aes128_cbc_decrypt_buffer(result, data, 16, key, iv);
-            break;
-        case ECB:
-            if(encrypt)
-                aes128_ebc_encrypt(data, key, result);
-            else
-                aes128_ebc_decrypt(data, key, result);
-            break;
-        }
-
-        db<Software_AES>(INF) << "Software_AES::" << (encrypt ? "en" : "de") << "crypt:result = {" << int(result[0]);
-        for(unsigned int i = 1; i < 16; i++)
-            db<Software_AES>(INF) << "," << int(result[i]);
-        db<Software_AES>(INF) << "}" << std::endl;
+    // Raw keys only get the round keys of the direction they are used in
+    const Key_Schedule & schedule(const unsigned char * key, bool decryption) {
+        if(0 != key)
+            _schedule.expand(key, false);
+        if(decryption && !_schedule._decryption)
+            _schedule.expand_decryption();
+        return _schedule;
     }
 
-    void aes128_cbc_encrypt_buffer(unsigned char * output, const unsigned char * input, int length, const unsigned char * key, unsigned char * iv);
-    void aes128_cbc_decrypt_buffer(unsigned char * output, const unsigned char * input, int length, const unsigned char * key, unsigned char * iv);
-    void aes128_ebc_encrypt(const unsigned char * input, const unsigned char * key, unsigned char *output);
-    void aes128_ebc_decrypt(const unsigned char * input, const unsigned char * key, unsigned char *output);
-
-    void expand_key(void);
-    void add_round_key(int round);
-    void sub_bytes(void);
-    void shift_rows(void);
-    void mix_columns(void);
-    void inv_mix_columns(void);
-    void inv_sub_bytes(void);
-    void inv_shift_rows(void);
+    void crypt(const void * data, size_t length, const Key_Schedule & key, unsigned char * result, unsigned char * iv, bool encrypt) const;
+    static void cbc_encrypt(const Key_Schedule & key, const unsigned char * input, size_t length, unsigned char * output, unsigned char * iv);
+    static void cbc_decrypt(const Key_Schedule & key, const unsigned char * input, size_t length, unsigned char * output, unsigned char * iv);
+    static void ctr(const Key_Schedule & key, const unsigned char * input, size_t length, unsigned char * output, unsigned char * counter);
+
+    // CCM* blocks B_0 and A_i: flags, nonce and a 2-byte big-endian message length or counter
+    static void ccm_block(unsigned char * block, unsigned char flags, const unsigned char * nonce, size_t n) {
+        assert(n <= 0xffff);
+        block[0] = flags;
+        std::memcpy(&block[1], nonce, CCM_NONCE_SIZE);
+        block[KEY_SIZE - 2] = n >> 8;
+        block[KEY_SIZE - 1] = n;
+    }
+    static void ccm_start(const Key_Schedule & key, const unsigned char * nonce, const unsigned char * header, size_t header_size,
+                          size_t payload_size, unsigned int mic_size, unsigned char * blocks, unsigned char * s0);
+
+    static void add_round_key(State & state, const Key_Schedule & key, int round);
+    static void sub_bytes(State & state);
+    static void shift_rows(State & state);
+    static void mix_columns(State & state);
+    static void inv_mix_columns(State & state);
+    static void inv_sub_bytes(State & state);
+    static void inv_shift_rows(State & state);
+
+    // Run the rounds on blocks consecutive blocks of data, in place
+    static void cipher(const Key_Schedule & key, unsigned char * data, unsigned int blocks = 1);
+    static void inv_cipher(const Key_Schedule & key, unsigned char * data, unsigned int blocks = 1);
+
+    // 32-bit T-tables: te[r][x] is the column mix_columns makes of sbox[x] in row r, and td[r][x] the one
+    // inv_mix_columns makes of rsbox[x], so a round is four lookups and four XORs per column
+    struct Tables {
+        Tables();
+
+        unsigned int te[4][256];
+        unsigned int td[4][256];
+    };
+    static const Tables & tables() {
+        static const Tables t; // built on first use
+        return t;
+    }
 
-    void cipher(void);
-    void inv_cipher(void);
+    static void t_table_cipher(const Key_Schedule & key, unsigned char * s);
+    static void t_table_inv_cipher(const Key_Schedule & key, unsigned char * s);
 
-    void block_copy(unsigned char * output, const unsigned char * input) { std::memmove(output, input, KEY_SIZE); }
+    static unsigned int word(const unsigned char * b) {
+        return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<unsigned int>(b[3]) << 24);
+    }
 
-    unsigned char xtime(unsigned char x) { return ((x<<1) ^ (((x>>7) & 1) * 0x1b)); }
-    unsigned char multiply(unsigned char x, unsigned char y) {
+    static unsigned char xtime(unsigned char x) { return ((x<<1) ^ (((x>>7) & 1) * 0x1b)); }
+    static unsigned char multiply(unsigned char x, unsigned char y) {
         return (((y & 1) * x) ^
                 ((y >> 1 & 1) * xtime(x)) ^
                 ((y >> 2 & 1) * xtime(xtime(x))) ^
@@ -118,16 +227,16 @@ private:
                 ((y >> 4 & 1) * xtime(xtime(xtime(xtime(x))))));
     }
 
-    void xor_with_iv(unsigned char * buf) { for(unsigned int i = 0; i < KEY_SIZE; ++i) buf[i] ^= _iv[i]; }
+    static void increment(unsigned char * counter) {
+        for(int i = KEY_SIZE - 1; (i >= 0) && !++counter[i]; i--);
+    }
 
 private:
     Mode _mode;
 
-    State * _state;
-    unsigned char _round_key[176];
-    const unsigned char * _key;
-    unsigned char * _iv; // initial Vector used only for CBC mode
-    unsigned char iv[23];
+    // Only used with raw keys
+    Key_Schedule _schedule; // round keys of the last raw key
+    unsigned char _chain[16]; // last CBC ciphertext block or next CTR counter block of raw key bulk calls
 
     static const unsigned char sbox[256];
     static const unsigned char rsbox[256];
@@ -137,8 +246,8 @@ private:
 // The lookup-tables are marked const so they can be placed in read-only storage instead of RAM
 // The numbers below can be computed dynamically trading ROM for RAM -
 // This can be useful in (embedded) bootloader applications, where ROM is often limited.
-template<unsigned int KEY_SIZE>
-const unsigned char Software_AES<KEY_SIZE>::sbox[256] = { // 0     1     2     3     4     5     6     7     8     9     a     b     c     d     e     f
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+const unsigned char Software_AES<KEY_SIZE, ENGINE, HARDWARE>::sbox[256] = { // 0     1     2     3     4     5     6     7     8     9     a     b     c     d     e     f
                                                           0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
                                                           0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
                                                           0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
@@ -156,8 +265,8 @@ const unsigned char Software_AES<KEY_SIZE>::sbox[256] = { // 0     1     2     3
                                                           0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
                                                           0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16 };
 
-template<unsigned int KEY_SIZE>
-const unsigned char Software_AES<KEY_SIZE>::rsbox[256] = {// 0     1     2     3     4     5     6     7     8     9     a     b     c     d     e     f
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+const unsigned char Software_AES<KEY_SIZE, ENGINE, HARDWARE>::rsbox[256] = {// 0     1     2     3     4     5     6     7     8     9     a     b     c     d     e     f
                                                           0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
                                                           0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
                                                           0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
@@ -179,8 +288,8 @@ const unsigned char Software_AES<KEY_SIZE>::rsbox[256] = {// 0     1     2     3
 // The round constant word array, rcon[i], contains the values given by
 // x to th e power (i-1) being powers of x (x is denoted as {02}) in the field GF(2^8)
 // Note that i starts at 1, not 0).
-template<unsigned int KEY_SIZE>
-const unsigned char Software_AES<KEY_SIZE>::rcon[255] = { // 0     1     2     3     4     5     6     7     8     9     a     b     c     d     e     f
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+const unsigned char Software_AES<KEY_SIZE, ENGINE, HARDWARE>::rcon[255] = { // 0     1     2     3     4     5     6     7     8     9     a     b     c     d     e     f
                                                           0x8d, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36, 0x6c, 0xd8, 0xab, 0x4d, 0x9a,
                                                           0x2f, 0x5e, 0xbc, 0x63, 0xc6, 0x97, 0x35, 0x6a, 0xd4, 0xb3, 0x7d, 0xfa, 0xef, 0xc5, 0x91, 0x39,
                                                           0x72, 0xe4, 0xd3, 0xbd, 0x61, 0xc2, 0x9f, 0x25, 0x4a, 0x94, 0x33, 0x66, 0xcc, 0x83, 0x1d, 0x3a,
@@ -198,122 +307,230 @@ const unsigned char Software_AES<KEY_SIZE>::rcon[255] = { // 0     1     2     3
                                                           0xc6, 0x97, 0x35, 0x6a, 0xd4, 0xb3, 0x7d, 0xfa, 0xef, 0xc5, 0x91, 0x39, 0x72, 0xe4, 0xd3, 0xbd,
                                                           0x61, 0xc2, 0x9f, 0x25, 0x4a, 0x94, 0x33, 0x66, 0xcc, 0x83, 0x1d, 0x3a, 0x74, 0xe8, 0xcb  };
 
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::aes128_ebc_encrypt(const unsigned char * input, const unsigned char * key, unsigned char * output)
+// The state of a call lives on its stack (and iv on the caller's), so calls with a Key_Schedule are reentrant
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::crypt(const void * data, size_t length, const Key_Schedule & key, unsigned char * result, unsigned char * iv, bool encrypt) const
 {
-    // Copy input to output, and work in-memory on output
-    block_copy(output, input);
-    _state = reinterpret_cast<State *>(output);
-
-    _key = key;
-    expand_key();
+    const unsigned char * input = reinterpret_cast<const unsigned char *>(data);
+
+    db<Software_AES>(TRC) << "Software_AES::" << (encrypt ? "en" : "de") << "crypt(data=" << data << ",length=" << length << ",key=" << reinterpret_cast<const void*>(&key) << ",result=" << reinterpret_cast<const void*>(result) << ",iv=" << reinterpret_cast<const void*>(iv) << ")" << std::endl;
+    db<Software_AES>(INF) << "Software_AES::" << (encrypt ? "en" : "de") << "crypt:data = {" << int(input[0]);
+    for(unsigned int i = 1; i < length; i++)
+        db<Software_AES>(INF) << "," << int(input[i]);
+    db<Software_AES>(INF) << "}" << std::endl;
+
+    // CTR decrypts by encrypting the counter too
+    assert(!INVERSE_KEYS || encrypt || (_mode == CTR) || key._decryption);
+
+    switch(_mode) {
+    case ECB:
+        assert(length % KEY_SIZE == 0);
+        if(result != input)
+            std::memmove(result, input, length);
+        if(encrypt)
+            cipher(key, result, length / KEY_SIZE);
+        else
+            inv_cipher(key, result, length / KEY_SIZE);
+        break;
+    case CBC:
+        assert(length % KEY_SIZE == 0);
+        if(encrypt)
+            cbc_encrypt(key, input, length, result, iv);
+        else
+            cbc_decrypt(key, input, length, result, iv);
+        break;
+    case CTR:
+        ctr(key, input, length, result, iv);
+        break;
+    }
 
-    // The next function call encrypts the PlainText with the _key using AES algorithm.
-    cipher();
+    db<Software_AES>(INF) << "Software_AES::" << (encrypt ? "en" : "de") << "crypt:result = {" << int(result[0]);
+    for(unsigned int i = 1; i < length; i++)
+        db<Software_AES>(INF) << "," << int(result[i]);
+    db<Software_AES>(INF) << "}" << std::endl;
 }
 
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::aes128_ebc_decrypt(const unsigned char * input, const unsigned char * key, unsigned char *output)
+// Each block depends on the previous ciphertext, so CBC encryption runs one block at a time
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::cbc_encrypt(const Key_Schedule & key, const unsigned char * input, size_t length, unsigned char * output, unsigned char * iv)
 {
-    // Copy input to output, and work in-memory on output
-    block_copy(output, input);
-    _state = reinterpret_cast<State *>(output);
-
-    // The expand_key routine must be called before encryption.
-    _key = key;
-    expand_key();
-
-    inv_cipher();
+    unsigned char block[KEY_SIZE];
+    std::memcpy(block, iv, KEY_SIZE);
+    for(size_t i = 0; i < length; i += KEY_SIZE) {
+        for(unsigned int j = 0; j < KEY_SIZE; j++)
+            block[j] ^= input[i + j];
+        cipher(key, block);
+        std::memcpy(&output[i], block, KEY_SIZE);
+    }
+    std::memcpy(iv, block, KEY_SIZE);
 }
 
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::aes128_cbc_encrypt_buffer(unsigned char * output, const unsigned char * _input, int length, const unsigned char * key, unsigned char * iv)
+// CBC decryption only needs the previous ciphertext after the rounds, so PIPELINE blocks go through them at once
+// (the ciphertext is kept apart, since output may overwrite input)
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::cbc_decrypt(const Key_Schedule & key, const unsigned char * input, size_t length, unsigned char * output, unsigned char * iv)
 {
-    unsigned char remainders = length % KEY_SIZE; /* Remaining bytes in the last non-full block */
-
-    block_copy(output, _input);
-    _state = reinterpret_cast<State *>(output);
-
-    // Skip the key expansion if key is passed as 0
-    if(0 != key) {
-        _key = key;
-        expand_key();
+    unsigned char ciphertext[PIPELINE * KEY_SIZE];
+
+    for(size_t i = 0; i < length; ) {
+        size_t n = (length - i < sizeof(ciphertext)) ? length - i : sizeof(ciphertext);
+        std::memcpy(ciphertext, &input[i], n);
+        std::memcpy(&output[i], ciphertext, n);
+        inv_cipher(key, &output[i], n / KEY_SIZE);
+        for(unsigned int j = 0; j < KEY_SIZE; j++)
+            output[i + j] ^= iv[j];
+        for(unsigned int j = KEY_SIZE; j < n; j++)
+            output[i + j] ^= ciphertext[j - KEY_SIZE];
+        std::memcpy(iv, &ciphertext[n - KEY_SIZE], KEY_SIZE);
+        i += n;
     }
+}
 
-    if(iv != 0)
-        _iv = iv;
+// Key stream for PIPELINE counter blocks at a time, XORed into the data
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::ctr(const Key_Schedule & key, const unsigned char * input, size_t length, unsigned char * output, unsigned char * counter)
+{
+    unsigned char stream[PIPELINE * KEY_SIZE];
+
+    for(size_t i = 0; i < length; ) {
+        size_t n = (length - i < sizeof(stream)) ? length - i : sizeof(stream);
+        unsigned int blocks = (n + KEY_SIZE - 1) / KEY_SIZE;
+        for(unsigned int b = 0; b < blocks; b++) {
+            std::memcpy(&stream[KEY_SIZE * b], counter, KEY_SIZE);
+            increment(counter);
+        }
+        cipher(key, stream, blocks);
+        for(size_t j = 0; j < n; j++)
+            output[i + j] = input[i + j] ^ stream[j];
+        i += n;
+    }
+}
 
-    int i;
-    for(i = 0; i < length; i += KEY_SIZE) {
-        unsigned char input[KEY_SIZE];
-        for(int j=0; (j<(int)KEY_SIZE) && (j+i < length); j++)
-            input[j] = _input[j+i];
-        xor_with_iv(input);
-        block_copy(output, input);
-        _state = reinterpret_cast<State *>(output);
-        cipher();
-        _iv = output;
-        output += KEY_SIZE;
-    }
-
-    if(remainders) {
-        block_copy(output, _input+i);
-        std::memset(output + remainders, 0, KEY_SIZE - remainders); /* add 0-padding */
-        _state = reinterpret_cast<State *>(output);
-        cipher();
+// X_1 and S_0 (from B_0 and A_0, through the rounds together), then the CBC-MAC of the header, prefixed with its
+// 2-byte length and zero-padded to a whole block, into blocks[0 .. KEY_SIZE - 1]
+// Without a MIC (M = 0), CCM* is plain CTR from A_1 and there is nothing to start
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::ccm_start(const Key_Schedule & key, const unsigned char * nonce, const unsigned char * header, size_t header_size,
+                                                          size_t payload_size, unsigned int mic_size, unsigned char * blocks, unsigned char * s0)
+{
+    assert((mic_size == 0) || ((mic_size >= 4) && (mic_size <= KEY_SIZE) && !(mic_size & 1)));
+    assert(header_size < 0xff00); // longer headers take a 6-byte length prefix
+
+    if(mic_size == 0)
+        return;
+
+    unsigned char * x = blocks;
+    unsigned char * s = &blocks[KEY_SIZE];
+    ccm_block(x, (header_size ? 0x40 : 0) | (((mic_size - 2) / 2) << 3) | 1, nonce, payload_size);
+    ccm_block(s, 1, nonce, 0);
+    cipher(key, blocks, 2);
+    std::memcpy(s0, s, KEY_SIZE);
+
+    if(header_size) {
+        x[0] ^= header_size >> 8;
+        x[1] ^= header_size;
+        unsigned int position = 2;
+        for(size_t i = 0; i < header_size; i++) {
+            x[position++] ^= header[i];
+            if(position == KEY_SIZE) {
+                cipher(key, x);
+                position = 0;
+            }
+        }
+        if(position)
+            cipher(key, x);
     }
 }
 
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::aes128_cbc_decrypt_buffer(unsigned char * output, const unsigned char * input, int length, const unsigned char * key, unsigned char * iv)
+// The CBC-MAC of each payload block and the key stream that encrypts it go through the rounds together
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::ccm_encrypt(const Key_Schedule & key, const unsigned char * nonce, const void * header, size_t header_size,
+                                                            unsigned char * payload, size_t payload_size, unsigned char * mic, unsigned int mic_size)
 {
-    int i;
-    unsigned char remainders = length % KEY_SIZE; /* Remaining bytes in the last non-full block */
+    unsigned char blocks[2 * KEY_SIZE]; // CBC-MAC state X_i followed by counter block A_i
+    unsigned char * x = blocks;
+    unsigned char * s = &blocks[KEY_SIZE];
+    unsigned char s0[KEY_SIZE];
+
+    ccm_start(key, nonce, reinterpret_cast<const unsigned char *>(header), header_size, payload_size, mic_size, blocks, s0);
+
+    for(size_t i = 0; i < payload_size; i += KEY_SIZE) {
+        size_t n = (payload_size - i < KEY_SIZE) ? payload_size - i : KEY_SIZE;
+        ccm_block(s, 1, nonce, i / KEY_SIZE + 1);
+        if(mic_size) {
+            for(size_t j = 0; j < n; j++)
+                x[j] ^= payload[i + j];
+            cipher(key, blocks, 2);
+        } else
+            cipher(key, s);
+        for(size_t j = 0; j < n; j++)
+            payload[i + j] ^= s[j];
+    }
 
-    block_copy(output, input);
-    _state = reinterpret_cast<State *>(output);
+    for(unsigned int j = 0; j < mic_size; j++)
+        mic[j] = x[j] ^ s0[j];
+}
 
-    // Skip the key expansion if key is passed as 0
-    if(0 != key) {
-        _key = key;
-        expand_key();
+// The CBC-MAC needs each plaintext block, only known after its key stream, so it runs one block behind:
+// the key stream of block i goes through the rounds together with the CBC-MAC of block i - 1
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+bool Software_AES<KEY_SIZE, ENGINE, HARDWARE>::ccm_decrypt(const Key_Schedule & key, const unsigned char * nonce, const void * header, size_t header_size,
+                                                            unsigned char * payload, size_t payload_size, const unsigned char * mic, unsigned int mic_size)
+{
+    unsigned char blocks[2 * KEY_SIZE]; // CBC-MAC state X_i followed by counter block A_i
+    unsigned char * x = blocks;
+    unsigned char * s = &blocks[KEY_SIZE];
+    unsigned char s0[KEY_SIZE];
+
+    ccm_start(key, nonce, reinterpret_cast<const unsigned char *>(header), header_size, payload_size, mic_size, blocks, s0);
+
+    bool pending = false; // whether x has a plaintext block XORed in that has not gone through the rounds yet
+    for(size_t i = 0; i < payload_size; i += KEY_SIZE) {
+        size_t n = (payload_size - i < KEY_SIZE) ? payload_size - i : KEY_SIZE;
+        ccm_block(s, 1, nonce, i / KEY_SIZE + 1);
+        if(pending)
+            cipher(key, blocks, 2);
+        else
+            cipher(key, s);
+        for(size_t j = 0; j < n; j++)
+            payload[i + j] ^= s[j];
+        if(mic_size) {
+            for(size_t j = 0; j < n; j++)
+                x[j] ^= payload[i + j];
+            pending = true;
+        }
     }
 
-    // If iv is passed as 0, we continue to encrypt without re-setting the _iv
-    if(iv != 0)
-        _iv = iv;
+    if(mic_size == 0)
+        return true;
 
-    for(i = 0; i < length; i += KEY_SIZE) {
-        block_copy(output, input);
-        _state = reinterpret_cast<State *>(output);
-        inv_cipher();
-        xor_with_iv(output);
-        _iv = const_cast<unsigned char *>(input);
-        input += KEY_SIZE;
-        output += KEY_SIZE;
-    }
+    if(pending)
+        cipher(key, x);
 
-    if(remainders) {
-        block_copy(output, input);
-        std::memset(output+remainders, 0, KEY_SIZE - remainders); /* add 0-padding */
-        _state = reinterpret_cast<State *>(output);
-        inv_cipher();
+    // Compare all bytes, so the time taken does not tell how many of them match
+    unsigned char difference = 0;
+    for(unsigned int j = 0; j < mic_size; j++)
+        difference |= x[j] ^ s0[j] ^ mic[j];
+    if(difference) {
+        std::memset(payload, 0, payload_size);
+        return false;
     }
+    return true;
 }
 
 // This function produces Nb(Nr+1) round keys. The round keys are used in each round to decrypt the states.
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::expand_key(void)
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::Key_Schedule::expand_encryption(const unsigned char * key)
 {
     unsigned int i, j, k;
     unsigned char tempa[4]; // Used for the column/row operations
 
     // The first round key is the key itself.
     for(i = 0; i < Nk; ++i) {
-        _round_key[(i * 4) + 0] = _key[(i * 4) + 0];
-        _round_key[(i * 4) + 1] = _key[(i * 4) + 1];
-        _round_key[(i * 4) + 2] = _key[(i * 4) + 2];
-        _round_key[(i * 4) + 3] = _key[(i * 4) + 3];
+        _round_key[(i * 4) + 0] = key[(i * 4) + 0];
+        _round_key[(i * 4) + 1] = key[(i * 4) + 1];
+        _round_key[(i * 4) + 2] = key[(i * 4) + 2];
+        _round_key[(i * 4) + 3] = key[(i * 4) + 3];
     }
 
     // All other round keys are found from the previous round keys.
@@ -362,202 +579,344 @@ void Software_AES<KEY_SIZE>::expand_key(void)
     }
 }
 
-// This function adds the round key to _state.
-// The round key is added to the _state by an XOR function.
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::add_round_key(int round)
+// Decryption round keys for T_TABLE and AES_Instructions (see INVERSE_KEYS): inv_mix_columns of the inner round keys,
+// which is td[r][sbox[x]] summed over the rows, since rsbox undoes sbox
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::Key_Schedule::expand_decryption()
+{
+    if(!INVERSE_KEYS)
+        return;
+
+    const Tables & t = tables();
+    for(unsigned int i = 0; i < sizeof(_inverse_round_key); i += 4) {
+        const unsigned char * k = &_round_key[i];
+        unsigned int w = word(k);
+        if((i >= Nb * 4) && (i < Nr * Nb * 4))
+            w = t.td[0][sbox[k[0]]] ^ t.td[1][sbox[k[1]]] ^ t.td[2][sbox[k[2]]] ^ t.td[3][sbox[k[3]]];
+        for(unsigned int j = 0; j < 4; j++)
+            _inverse_round_key[i + j] = w >> (8 * j);
+    }
+    _decryption = true;
+}
+
+// This function adds the round key to state.
+// The round key is added to the state by an XOR function.
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::add_round_key(State & state, const Key_Schedule & key, int round)
 {
     int i,j;
     for(i=0;i<4;++i) {
         for(j = 0; j < 4; ++j) {
-            (*_state)[i][j] ^= _round_key[round * Nb * 4 + i * Nb + j];
+            state[i][j] ^= key._round_key[round * Nb * 4 + i * Nb + j];
         }
     }
 }
 
 // The sub_bytes Function Substitutes the values in the
-// _state matrix with values in an S-box.
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::sub_bytes(void)
+// state matrix with values in an S-box.
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::sub_bytes(State & state)
 {
     int i, j;
     for(i = 0; i < 4; ++i) {
         for(j = 0; j < 4; ++j) {
-            (*_state)[j][i] = sbox[static_cast<int>((*_state)[j][i])];
+            state[j][i] = sbox[static_cast<int>(state[j][i])];
         }
     }
 }
 
-// The shift_rows() function shifts the rows in the _state to the left.
+// The shift_rows() function shifts the rows in the state to the left.
 // Each row is shifted with different offset.
 // Offset = Row number. So the first row is not shifted.
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::shift_rows(void)
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::shift_rows(State & state)
 {
     unsigned char temp;
 
     // Rotate first row 1 columns to left
-    temp           = (*_state)[0][1];
-    (*_state)[0][1] = (*_state)[1][1];
-    (*_state)[1][1] = (*_state)[2][1];
-    (*_state)[2][1] = (*_state)[3][1];
-    (*_state)[3][1] = temp;
+    temp           = state[0][1];
+    state[0][1] = state[1][1];
+    state[1][1] = state[2][1];
+    state[2][1] = state[3][1];
+    state[3][1] = temp;
 
     // Rotate second row 2 columns to left
-    temp           = (*_state)[0][2];
-    (*_state)[0][2] = (*_state)[2][2];
-    (*_state)[2][2] = temp;
+    temp           = state[0][2];
+    state[0][2] = state[2][2];
+    state[2][2] = temp;
 
-    temp       = (*_state)[1][2];
-    (*_state)[1][2] = (*_state)[3][2];
-    (*_state)[3][2] = temp;
+    temp       = state[1][2];
+    state[1][2] = state[3][2];
+    state[3][2] = temp;
 
     // Rotate third row 3 columns to left
-    temp       = (*_state)[0][3];
-    (*_state)[0][3] = (*_state)[3][3];
-    (*_state)[3][3] = (*_state)[2][3];
-    (*_state)[2][3] = (*_state)[1][3];
-    (*_state)[1][3] = temp;
+    temp       = state[0][3];
+    state[0][3] = state[3][3];
+    state[3][3] = state[2][3];
+    state[2][3] = state[1][3];
+    state[1][3] = temp;
 }
 
-// mix_columns function mixes the columns of the _state matrix
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::mix_columns(void)
+// mix_columns function mixes the columns of the state matrix
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::mix_columns(State & state)
 {
     int i;
-    unsigned char Tmp,Tm,t;
+    unsigned char a, b, c, d, Tmp;
     for(i = 0; i < 4; ++i)
     {
-        t   = (*_state)[i][0];
-        Tmp = (*_state)[i][0] ^ (*_state)[i][1] ^ (*_state)[i][2] ^ (*_state)[i][3] ;
-        Tm  = (*_state)[i][0] ^ (*_state)[i][1] ; Tm = xtime(Tm);  (*_state)[i][0] ^= Tm ^ Tmp ;
-        Tm  = (*_state)[i][1] ^ (*_state)[i][2] ; Tm = xtime(Tm);  (*_state)[i][1] ^= Tm ^ Tmp ;
-        Tm  = (*_state)[i][2] ^ (*_state)[i][3] ; Tm = xtime(Tm);  (*_state)[i][2] ^= Tm ^ Tmp ;
-        Tm  = (*_state)[i][3] ^ t ;        Tm = xtime(Tm);  (*_state)[i][3] ^= Tm ^ Tmp ;
+        // The whole column is read before any of it is written back
+        a = state[i][0];
+        b = state[i][1];
+        c = state[i][2];
+        d = state[i][3];
+        Tmp = a ^ b ^ c ^ d;
+        state[i][0] = a ^ Tmp ^ xtime(a ^ b);
+        state[i][1] = b ^ Tmp ^ xtime(b ^ c);
+        state[i][2] = c ^ Tmp ^ xtime(c ^ d);
+        state[i][3] = d ^ Tmp ^ xtime(d ^ a);
     }
 }
 
-// mix_columns function mixes the columns of the _state matrix.
+// mix_columns function mixes the columns of the state matrix.
 // The method used to multiply may be difficult to understand for the inexperienced.
 // Please use the references to gain more information.
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::inv_mix_columns(void)
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::inv_mix_columns(State & state)
 {
     int i;
     unsigned char a,b,c,d;
     for(i = 0; i < 4; ++i) {
-        a = (*_state)[i][0];
-        b = (*_state)[i][1];
-        c = (*_state)[i][2];
-        d = (*_state)[i][3];
-
-        (*_state)[i][0] = multiply(a, 0x0e) ^ multiply(b, 0x0b) ^ multiply(c, 0x0d) ^ multiply(d, 0x09);
-        (*_state)[i][1] = multiply(a, 0x09) ^ multiply(b, 0x0e) ^ multiply(c, 0x0b) ^ multiply(d, 0x0d);
-        (*_state)[i][2] = multiply(a, 0x0d) ^ multiply(b, 0x09) ^ multiply(c, 0x0e) ^ multiply(d, 0x0b);
-        (*_state)[i][3] = multiply(a, 0x0b) ^ multiply(b, 0x0d) ^ multiply(c, 0x09) ^ multiply(d, 0x0e);
+        a = state[i][0];
+        b = state[i][1];
+        c = state[i][2];
+        d = state[i][3];
+
+        state[i][0] = multiply(a, 0x0e) ^ multiply(b, 0x0b) ^ multiply(c, 0x0d) ^ multiply(d, 0x09);
+        state[i][1] = multiply(a, 0x09) ^ multiply(b, 0x0e) ^ multiply(c, 0x0b) ^ multiply(d, 0x0d);
+        state[i][2] = multiply(a, 0x0d) ^ multiply(b, 0x09) ^ multiply(c, 0x0e) ^ multiply(d, 0x0b);
+        state[i][3] = multiply(a, 0x0b) ^ multiply(b, 0x0d) ^ multiply(c, 0x09) ^ multiply(d, 0x0e);
     }
 }
 
 
 // The sub_bytes Function Substitutes the values in the
-// _state matrix with values in an S-box.
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::inv_sub_bytes(void)
+// state matrix with values in an S-box.
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::inv_sub_bytes(State & state)
 {
     int i,j;
     for(i=0;i<4;++i) {
         for(j=0;j<4;++j) {
-            (*_state)[j][i] = rsbox[static_cast<int>((*_state)[j][i])];
+            state[j][i] = rsbox[static_cast<int>(state[j][i])];
         }
     }
 }
 
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::inv_shift_rows(void)
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::inv_shift_rows(State & state)
 {
     unsigned char temp;
 
     // Rotate first row 1 columns to right
-    temp=(*_state)[3][1];
-    (*_state)[3][1]=(*_state)[2][1];
-    (*_state)[2][1]=(*_state)[1][1];
-    (*_state)[1][1]=(*_state)[0][1];
-    (*_state)[0][1]=temp;
+    temp=state[3][1];
+    state[3][1]=state[2][1];
+    state[2][1]=state[1][1];
+    state[1][1]=state[0][1];
+    state[0][1]=temp;
 
     // Rotate second row 2 columns to right
-    temp=(*_state)[0][2];
-    (*_state)[0][2]=(*_state)[2][2];
-    (*_state)[2][2]=temp;
+    temp=state[0][2];
+    state[0][2]=state[2][2];
+    state[2][2]=temp;
 
-    temp=(*_state)[1][2];
-    (*_state)[1][2]=(*_state)[3][2];
-    (*_state)[3][2]=temp;
+    temp=state[1][2];
+    state[1][2]=state[3][2];
+    state[3][2]=temp;
 
     // Rotate third row 3 columns to right
-    temp=(*_state)[0][3];
-    (*_state)[0][3]=(*_state)[1][3];
-    (*_state)[1][3]=(*_state)[2][3];
-    (*_state)[2][3]=(*_state)[3][3];
-    (*_state)[3][3]=temp;
+    temp=state[0][3];
+    state[0][3]=state[1][3];
+    state[1][3]=state[2][3];
+    state[2][3]=state[3][3];
+    state[3][3]=temp;
 }
 
 
 // cipher is the main function that encrypts the PlainText.
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::cipher(void)
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::cipher(const Key_Schedule & key, unsigned char * data, unsigned int blocks)
 {
-    unsigned char round = 0;
+    if(HARDWARE && AES_Instructions::available()) {
+        AES_Instructions::encrypt(key._round_key, data, data, blocks);
+        return;
+    }
+    if(ENGINE == Traits<Cipher>::T_TABLE) {
+        for(; blocks; blocks--, data += KEY_SIZE)
+            t_table_cipher(key, data);
+        return;
+    }
 
-    // Add the First round key to the _state before starting the rounds.
-    add_round_key(0);
+    for(; blocks; blocks--, data += KEY_SIZE) {
+        // Working on a copy lets the compiler keep the state in registers
+        State state;
+        std::memcpy(state, data, KEY_SIZE);
+
+        unsigned char round = 0;
+
+        // Add the First round key to the state before starting the rounds.
+        add_round_key(state, key, 0);
+
+        // There will be Nr rounds.
+        // The first Nr-1 rounds are identical.
+        // These Nr-1 rounds are executed in the loop below.
+        for(round = 1; round < Nr; ++round)
+        {
+            sub_bytes(state);
+            shift_rows(state);
+            mix_columns(state);
+            add_round_key(state, key, round);
+        }
 
-    // There will be Nr rounds.
-    // The first Nr-1 rounds are identical.
-    // These Nr-1 rounds are executed in the loop below.
-    for(round = 1; round < Nr; ++round)
-    {
-        sub_bytes();
-        shift_rows();
-        mix_columns();
-        add_round_key(round);
+        // The last round is given below.
+        // The mix_columns function is not here in the last round.
+        sub_bytes(state);
+        shift_rows(state);
+        add_round_key(state, key, Nr);
+
+        std::memcpy(data, state, KEY_SIZE);
+    }
+}
+
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::inv_cipher(const Key_Schedule & key, unsigned char * data, unsigned int blocks)
+{
+    if(HARDWARE && AES_Instructions::available()) {
+        AES_Instructions::decrypt(key._inverse_round_key, data, data, blocks);
+        return;
+    }
+    if(ENGINE == Traits<Cipher>::T_TABLE) {
+        for(; blocks; blocks--, data += KEY_SIZE)
+            t_table_inv_cipher(key, data);
+        return;
+    }
+
+    for(; blocks; blocks--, data += KEY_SIZE) {
+        // Working on a copy lets the compiler keep the state in registers
+        State state;
+        std::memcpy(state, data, KEY_SIZE);
+
+        unsigned char round=0;
+
+        // Add the First round key to the state before starting the rounds.
+        add_round_key(state, key, Nr);
+
+        // There will be Nr rounds.
+        // The first Nr-1 rounds are identical.
+        // These Nr-1 rounds are executed in the loop below.
+        for(round = Nr - 1; round > 0; round--) {
+            inv_shift_rows(state);
+            inv_sub_bytes(state);
+            add_round_key(state, key, round);
+            inv_mix_columns(state);
+        }
+
+        // The last round is given below.
+        // The mix_columns function is not here in the last round.
+        inv_shift_rows(state);
+        inv_sub_bytes(state);
+        add_round_key(state, key, 0);
+
+        std::memcpy(data, state, KEY_SIZE);
     }
+}
+
 
-    // The last round is given below.
-    // The mix_columns function is not here in the last round.
-    sub_bytes();
-    shift_rows();
-    add_round_key(Nr);
+
+
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+Software_AES<KEY_SIZE, ENGINE, HARDWARE>::Tables::Tables()
+{
+    for(unsigned int x = 0; x < 256; x++) {
+        unsigned char s = sbox[x];
+        unsigned char r = rsbox[x];
+        unsigned int e = multiply(s, 0x02) | (s << 8) | (s << 16) | (static_cast<unsigned int>(multiply(s, 0x03)) << 24);
+        unsigned int d = multiply(r, 0x0e) | (multiply(r, 0x09) << 8) | (multiply(r, 0x0d) << 16) | (static_cast<unsigned int>(multiply(r, 0x0b)) << 24);
+
+        // Row i of a column feeds the same products, rotated down by i rows
+        for(unsigned int i = 0; i < 4; i++) {
+            te[i][x] = i ? (e << (8 * i)) | (e >> (32 - 8 * i)) : e;
+            td[i][x] = i ? (d << (8 * i)) | (d >> (32 - 8 * i)) : d;
+        }
+    }
 }
 
-template<unsigned int KEY_SIZE>
-void Software_AES<KEY_SIZE>::inv_cipher(void)
+// Columns are little-endian words (row 0 in the low byte); after shift_rows, row r of column c comes from column c + r
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::t_table_cipher(const Key_Schedule & key, unsigned char * s)
 {
-    unsigned char round=0;
-
-    // Add the First round key to the _state before starting the rounds.
-    add_round_key(Nr);
-
-    // There will be Nr rounds.
-    // The first Nr-1 rounds are identical.
-    // These Nr-1 rounds are executed in the loop below.
-    for(round = Nr - 1; round > 0; round--) {
-        inv_shift_rows();
-        inv_sub_bytes();
-        add_round_key(round);
-        inv_mix_columns();
-    }
-
-    // The last round is given below.
-    // The mix_columns function is not here in the last round.
-    inv_shift_rows();
-    inv_sub_bytes();
-    add_round_key(0);
+    const Tables & t = tables();
+    const unsigned char * k = key._round_key;
+    unsigned int w[4], x[4];
+
+    for(unsigned int c = 0; c < 4; c++)
+        w[c] = word(&s[4 * c]) ^ word(&k[4 * c]);
+
+    for(int round = 1; round < Nr; round++) {
+        k += Nb * 4;
+        for(unsigned int c = 0; c < 4; c++)
+            x[c] = t.te[0][w[c] & 0xff] ^ t.te[1][(w[(c + 1) & 3] >> 8) & 0xff]
+                 ^ t.te[2][(w[(c + 2) & 3] >> 16) & 0xff] ^ t.te[3][w[(c + 3) & 3] >> 24] ^ word(&k[4 * c]);
+        for(unsigned int c = 0; c < 4; c++)
+            w[c] = x[c];
+    }
+
+    // The last round has no mix_columns
+    k += Nb * 4;
+    for(unsigned int c = 0; c < 4; c++) {
+        s[4 * c + 0] = sbox[w[c] & 0xff] ^ k[4 * c + 0];
+        s[4 * c + 1] = sbox[(w[(c + 1) & 3] >> 8) & 0xff] ^ k[4 * c + 1];
+        s[4 * c + 2] = sbox[(w[(c + 2) & 3] >> 16) & 0xff] ^ k[4 * c + 2];
+        s[4 * c + 3] = sbox[w[(c + 3) & 3] >> 24] ^ k[4 * c + 3];
+    }
 }
 
+// Equivalent inverse cipher: the same structure as t_table_cipher(), with inv_shift_rows taking row r of column c
+// from column c - r and the inner rounds using the inv_mix_columns'd round keys
+template<unsigned int KEY_SIZE, unsigned int ENGINE, bool HARDWARE>
+void Software_AES<KEY_SIZE, ENGINE, HARDWARE>::t_table_inv_cipher(const Key_Schedule & key, unsigned char * s)
+{
+    const Tables & t = tables();
+    const unsigned char * k = &key._inverse_round_key[Nr * Nb * 4];
+    unsigned int w[4], x[4];
+
+    for(unsigned int c = 0; c < 4; c++)
+        w[c] = word(&s[4 * c]) ^ word(&k[4 * c]);
+
+    for(int round = Nr - 1; round > 0; round--) {
+        k -= Nb * 4;
+        for(unsigned int c = 0; c < 4; c++)
+            x[c] = t.td[0][w[c] & 0xff] ^ t.td[1][(w[(c + 3) & 3] >> 8) & 0xff]
+                 ^ t.td[2][(w[(c + 2) & 3] >> 16) & 0xff] ^ t.td[3][w[(c + 1) & 3] >> 24] ^ word(&k[4 * c]);
+        for(unsigned int c = 0; c < 4; c++)
+            w[c] = x[c];
+    }
 
+    k -= Nb * 4;
+    for(unsigned int c = 0; c < 4; c++) {
+        s[4 * c + 0] = rsbox[w[c] & 0xff] ^ k[4 * c + 0];
+        s[4 * c + 1] = rsbox[(w[(c + 3) & 3] >> 8) & 0xff] ^ k[4 * c + 1];
+        s[4 * c + 2] = rsbox[(w[(c + 2) & 3] >> 16) & 0xff] ^ k[4 * c + 2];
+        s[4 * c + 3] = rsbox[w[(c + 1) & 3] >> 24] ^ k[4 * c + 3];
+    }
+}
 
 
-class Cipher: public Software_AES<> {};
+class Cipher: public Software_AES<16, Traits<Cipher>::ENGINE, Traits<Cipher>::HARDWARE>
+{
+public:
+    Cipher(const Mode & m = ECB): Software_AES<16, Traits<Cipher>::ENGINE, Traits<Cipher>::HARDWARE>(m) {}
+};
 
 __END_SYS
 
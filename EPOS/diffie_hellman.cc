@@ -78,6 +78,133 @@ Diffie_Hellman::Shared_Key Diffie_Hellman::shared_key(Elliptic_Curve_Point publi
     return public_key.x;
 }
 
+void Diffie_Hellman::shared_keys(const Public_Key * public_keys, const Private_Key * private_keys, Shared_Key * shared_keys, size_t n)
+{
+    db<Diffie_Hellman>(TRC) << "Diffie_Hellman::shared_keys(n=" << n << ")" << std::endl;
+
+    static const unsigned int BATCH = Traits<Diffie_Hellman>::BATCH_SIZE;
+
+    Jacobian_Point r[BATCH];
+    Bignum z[BATCH], products[BATCH];
+    bool infinity[BATCH];
+    const Bignum zero(0), one(1);
+
+    for(size_t base = 0; base < n; base += BATCH) {
+        unsigned int m = ((n - base) < BATCH) ? (n - base) : BATCH;
+
+        // Multiply every point, keeping the Jacobian results
+        for(unsigned int i = 0; i < m; i++) {
+            r[i] = Jacobian_Point(public_keys[base + i]);
+            if(private_keys[base + i] == zero)
+                r[i].z = 0;
+            else
+                r[i].multiply(private_keys[base + i]);
+
+            // The point at infinity has z = 0, which invert() maps to 0 on its own; keep it out of the products
+            z[i] = Jacobian_Point::bignum(r[i].z);
+            infinity[i] = (z[i] == zero);
+            z[i].conditional_assign(one, infinity[i]);
+
+            products[i] = z[i];
+            if(i > 0)
+                products[i] *= products[i - 1];
+        }
+
+        // Montgomery's trick: a single inversion of z[0] * ... * z[m-1] yields every 1/z[i]
+        Bignum inverse(products[m - 1]);
+        inverse.invert();
+
+        for(int i = m - 1; i >= 0; i--) {
+            Bignum z_inverse(inverse);
+            if(i > 0) {
+                z_inverse *= products[i - 1];
+                inverse *= z[i];
+            }
+            z_inverse.conditional_assign(zero, infinity[i]);
+
+            Bignum x(Jacobian_Point::bignum(r[i].x)), y(Jacobian_Point::bignum(r[i].y)), Z(z_inverse);
+            Z.square();
+            x *= Z;
+            Z *= z_inverse;
+            y *= Z;
+
+            x ^= y;
+            shared_keys[base + i] = x;
+        }
+    }
+}
+
+class Diffie_Hellman::Generator_Table
+{
+public:
+    static const unsigned int W = Traits<Diffie_Hellman>::GENERATOR_WINDOW_BITS;
+    static const unsigned int WINDOWS = (SECRET_SIZE * 8 + W - 1) / W;
+    static const unsigned int ENTRIES = 1 << (W - 1);
+
+public:
+    // rows[j][i] = (2 * i + 1) * 2^(W * j) * G, in affine coordinates
+    Generator_Table() {
+        Jacobian_Point base(Elliptic_Curve_Point(Bignum(_default_base_point_x, SECRET_SIZE), Bignum(_default_base_point_y, SECRET_SIZE)));
+
+        for(unsigned int j = 0; j <= WINDOWS; j++) {
+            Jacobian_Point twice(base);
+            twice.jacobian_double();
+            rows[j][0] = base;
+            for(unsigned int i = 1; i < ENTRIES; i++) {
+                rows[j][i] = rows[j][i - 1];
+                rows[j][i].add_jacobian(twice);
+            }
+            for(unsigned int i = 1; i < ENTRIES; i++)
+                rows[j][i].normalize();
+
+            for(unsigned int i = 0; i < W; i++)
+                base.jacobian_double();
+            base.normalize();
+        }
+    }
+
+    Jacobian_Point rows[WINDOWS + 1][ENTRIES];
+};
+
+const Diffie_Hellman::Generator_Table & Diffie_Hellman::generator_table()
+{
+    static const Generator_Table table;
+    return table;
+}
+
+void Diffie_Hellman::generator_multiply(Elliptic_Curve_Point & p, const Bignum & k)
+{
+    db<Diffie_Hellman>(TRC) << "Diffie_Hellman::generator_multiply(k=" << k << ")" << std::endl;
+
+    if(k == Bignum(0)) {
+        p.x = 0;
+        p.y = 0;
+        p.z = 0;
+        return;
+    }
+
+    const Generator_Table & table = generator_table();
+
+    // k * G = sum(digit j * 2^(W * j) * G), so each window is a single mixed addition of a table entry
+    int digits[Generator_Table::WINDOWS + 1];
+    bool even = Jacobian_Point::recode(digits, k, Generator_Table::W);
+
+    Jacobian_Point r, q;
+    r.select(table.rows[0], Generator_Table::ENTRIES, digits[0]);
+    for(unsigned int j = 1; j <= Generator_Table::WINDOWS; j++) {
+        q.select(table.rows[j], Generator_Table::ENTRIES, digits[j]);
+        r.add_jacobian_affine(q);
+    }
+
+    // recode() used k + 1 for an even k, so subtract G once more
+    q.select(table.rows[0], 1, -1);
+    Jacobian_Point s(r);
+    s.add_jacobian_affine(q);
+    r.conditional_assign(s, even);
+
+    p = r;
+}
+
 // Validate point: y^2 ≡ x^3 + ax + b (mod p)
 bool Diffie_Hellman::is_valid_point(const Elliptic_Curve_Point& point) {
     // Check if x, y are in [0, p-1]
@@ -96,12 +223,18 @@ bool Diffie_Hellman::is_valid_point(const Elliptic_Curve_Point& point) {
     Bignum curve_b = Bignum(curve_b_buffer, SECRET_SIZE); // b = 0xB4050A850C1B0A8D
     db<Bignum>(INF) << "Diffie_Hellman::is_valid_point(curve_b=" << curve_b << ")" << std::endl;
 
-    Bignum left = y * y;                    // y^2
-    Bignum right = x * x * x;               // x^3
+    Bignum left = y;
+    left.square();                          // y^2
+    Bignum right = x;
+    right.square();
+    right *= x;                             // x^3
 
     db<Bignum>(INF) << "Diffie_Hellman::is_valid_point(left=" << left << ",right=" << right << ")" << std::endl;
 
-    right -= (x * 3);                       // x^3 - 3x (since a = -3)
+    Bignum aux = x;
+    aux += x;
+    aux += x;
+    right -= aux;                           // x^3 - 3x (since a = -3)
     right += curve_b;                       // x^3 - 3x + b
     left -= right;                          // y^2 - (x^3 - 3x + b)
 
@@ -115,25 +248,64 @@ bool Diffie_Hellman::is_valid_point(const Elliptic_Curve_Point& point) {
 void Diffie_Hellman::Elliptic_Curve_Point::operator*=(const Coordinate & b)
 {
     db<Diffie_Hellman>(TRC) << "Diffie_Hellman::Elliptic_Curve_Point::operator*=(b=" << b << ") = " << *this << std::endl;
-    // Finding last '1' bit of b
-    static const unsigned int bits_in_digit = sizeof(typename Coordinate::Digit) * 8;
 
-    typename Coordinate::Digit now;
-    unsigned int b_len = sizeof(Coordinate) / sizeof(typename Coordinate::Digit);
-    for(; (b_len > 1) && (b[b_len - 1] == 0); b_len--);
-    if((b_len == 0) || (b[b_len - 1] == 0)) {
+    if(b == Coordinate(0)) {
         x = 0;
         y = 0;
         z = 0;
         return;
     }
 
+    // Enter the Field representation
+    Jacobian_Point r(*this);
+    r.multiply(b);
+
+    *this = r;
+}
+
+void Diffie_Hellman::Elliptic_Curve_Point::operator=(const Jacobian_Point & p)
+{
+    x = Jacobian_Point::bignum(p.x);
+    y = Jacobian_Point::bignum(p.y);
+    z = Jacobian_Point::bignum(p.z);
+
+    Coordinate Z;
+    z.invert();
+    Z = z;
+    Z.square();
+
+    x *= Z;
+    Z *= z;
+
+    y *= Z;
+    z = 1;
+}
+
+void Diffie_Hellman::Jacobian_Point::multiply(const Bignum & k)
+{
+    if(Traits<Diffie_Hellman>::MULTIPLICATION == Traits<Diffie_Hellman>::WINDOW)
+        window_multiply(k);
+    else if(Traits<Diffie_Hellman>::MULTIPLICATION == Traits<Diffie_Hellman>::LADDER)
+        ladder_multiply(k);
+    else
+        binary_multiply(k);
+}
+
+void Diffie_Hellman::Jacobian_Point::binary_multiply(const Bignum & b)
+{
+    // Finding last '1' bit of b
+    static const unsigned int bits_in_digit = sizeof(typename Bignum::Digit) * 8;
+
+    typename Bignum::Digit now;
+    unsigned int b_len = sizeof(Bignum) / sizeof(typename Bignum::Digit);
+    for(; (b_len > 1) && (b[b_len - 1] == 0); b_len--);
+
     now = b[b_len - 1];
 
     bool bin[bits_in_digit]; // Binary representation of 'now'
     unsigned int current_bit = bits_in_digit;
 
-    Elliptic_Curve_Point pp(*this);
+    Jacobian_Point pp(*this);
 
     for(int i = bits_in_digit - 1; i >= 0; i--) {
         if(now % 2)
@@ -157,48 +329,262 @@ void Diffie_Hellman::Elliptic_Curve_Point::operator*=(const Coordinate & b)
             current_bit = 0;
         }
     }
+}
 
-    Coordinate Z;
-    z.invert();
-    Z = z;
-    Z *= z;
+void Diffie_Hellman::Jacobian_Point::window_multiply(const Bignum & k)
+{
+    static const unsigned int W = Traits<Diffie_Hellman>::WINDOW_BITS;
+    static const unsigned int WINDOWS = (sizeof(Bignum) * 8 + W - 1) / W;
+
+    // table[i] = (2 * i + 1) * this
+    Jacobian_Point table[1 << (W - 1)];
+    Jacobian_Point twice(*this);
+    twice.jacobian_double();
+    table[0] = *this;
+    for(unsigned int i = 1; i < (1 << (W - 1)); i++) {
+        table[i] = table[i - 1];
+        table[i].add_jacobian(twice);
+    }
 
-    x *= Z;
-    Z *= z;
+    int digits[WINDOWS + 1];
+    bool even = recode(digits, k, W);
 
-    y *= Z;
+    select(table, 1 << (W - 1), digits[WINDOWS]);
+    for(int i = WINDOWS - 1; i >= 0; i--) {
+        for(unsigned int j = 0; j < W; j++)
+            jacobian_double();
+        Jacobian_Point q;
+        q.select(table, 1 << (W - 1), digits[i]);
+        add_jacobian(q);
+    }
+
+    // recode() used k + 1 for an even k, so subtract this once more
+    Jacobian_Point q;
+    q.select(table, 1, -1);
+    q.add_jacobian(*this);
+    conditional_assign(q, even);
+}
+
+// Regular signed-digit recoding: k' = sum(digits[i] * 2^(w * i)), with odd digits in [-(2^w - 1), 2^w - 1]
+// Since no digit is zero, every window costs the same w doublings and one addition
+// k' = k for odd k and k' = k + 1 for even k, in which case true is returned
+// digits must have room for ceil(bits(k) / w) + 1 entries
+bool Diffie_Hellman::Jacobian_Point::recode(int * digits, const Bignum & k, unsigned int w)
+{
+    typedef Bignum::Digit Digit;
+    static const unsigned int DIGITS = Bignum::DIGITS;
+    static const unsigned int BITS_PER_DIGIT = Bignum::BITS_PER_DIGIT;
+    const unsigned int windows = (DIGITS * BITS_PER_DIGIT + w - 1) / w;
+    const Digit mask = (Digit(1) << (w + 1)) - 1;
+
+    Digit e[DIGITS + 1];
+    for(unsigned int i = 0; i < DIGITS; i++)
+        e[i] = k[i];
+    e[DIGITS] = 0;
+
+    bool even = !(e[0] & 1);
+    Digit carry = even;
+    for(unsigned int i = 0; i <= DIGITS; i++) {
+        e[i] += carry;
+        carry = (e[i] < carry);
+    }
+
+    for(unsigned int j = 0; j < windows; j++) {
+        // digit = (e % 2^(w + 1)) - 2^w; e = (e - digit) / 2^w
+        digits[j] = int(e[0] & mask) - (1 << w);
+        e[0] = (e[0] & ~mask) | (Digit(1) << w);
+        for(unsigned int i = 0; i < DIGITS; i++)
+            e[i] = (e[i] >> w) | (e[i + 1] << (BITS_PER_DIGIT - w));
+        e[DIGITS] >>= w;
+    }
+    digits[windows] = e[0];
+
+    return even;
+}
+
+// this = digit * P, with odd_multiples[i] = (2 * i + 1) * P, without branching on digit
+void Diffie_Hellman::Jacobian_Point::select(const Jacobian_Point * odd_multiples, unsigned int entries, int digit)
+{
+    unsigned int negative = static_cast<unsigned int>(digit) >> (sizeof(int) * 8 - 1);
+    unsigned int index = ((static_cast<unsigned int>(digit) ^ -negative) + negative) >> 1;
+
+    for(unsigned int i = 0; i < entries; i++)
+        conditional_assign(odd_multiples[i], i == index);
+
+    Coordinate minus_y(0);
+    minus_y -= y;
+    y.conditional_assign(minus_y, negative);
+}
+
+// this = (x / z^2, y / z^3, 1)
+void Diffie_Hellman::Jacobian_Point::normalize()
+{
+    Bignum inverse(bignum(z));
+    inverse.invert();
+
+    Coordinate Z(inverse), aux(inverse);
+    aux.square();
+    x *= aux;
+    aux *= Z;
+    y *= aux;
     z = 1;
 }
 
-void Diffie_Hellman::Elliptic_Curve_Point::jacobian_double()
+void Diffie_Hellman::Jacobian_Point::conditional_assign(const Jacobian_Point & b, bool condition)
+{
+    x.conditional_assign(b.x, condition);
+    y.conditional_assign(b.y, condition);
+    z.conditional_assign(b.z, condition);
+}
+
+void Diffie_Hellman::Jacobian_Point::conditional_swap(Jacobian_Point & a, Jacobian_Point & b, bool condition)
+{
+    Jacobian_Point tmp(a);
+    a.conditional_assign(b, condition);
+    b.conditional_assign(tmp, condition);
+}
+
+// Montgomery ladder keeping R0 = k' * this and R1 = (k' + 1) * this for the leading bits k' of k.
+// Both points share the same z along the ladder, so only x and y are updated and z is never computed:
+// it is recovered at the end from R1 - R0 = this, which must be in affine coordinates.
+void Diffie_Hellman::Jacobian_Point::ladder_multiply(const Bignum & k)
+{
+    static const unsigned int bits_in_digit = sizeof(typename Bignum::Digit) * 8;
+
+    // Recovering z divides by this.x, so a point with x = 0 (e.g. (0, sqrt(b)) on secp128r1) takes the window method
+    // (this is the public point, so branching on it reveals nothing about k)
+    if(x == Coordinate(0)) {
+        window_multiply(k);
+        return;
+    }
+
+    int bit = sizeof(Bignum) * 8 - 1;
+    for(; (bit > 0) && !((k[bit / bits_in_digit] >> (bit % bits_in_digit)) & 1); bit--);
+
+    // R1 = 2 * this and R0 = this, with z = 2y (a = -3)
+    Jacobian_Point r[2];
+    Coordinate M(x), aux(x), y2(y);
+    M -= Coordinate(1); aux += Coordinate(1); M *= aux;
+    aux = M; M += aux; M += aux;
+
+    y2.square();
+    r[0].x = y2; r[0].x *= x; r[0].x += r[0].x; r[0].x += r[0].x;
+    r[0].y = y2; r[0].y.square(); r[0].y += r[0].y; r[0].y += r[0].y; r[0].y += r[0].y;
+
+    r[1].x = M; r[1].x.square();
+    r[1].x -= r[0].x; r[1].x -= r[0].x;
+    r[1].y = r[0].x; r[1].y -= r[1].x; r[1].y *= M;
+    r[1].y -= r[0].y;
+
+    // swapped tells whether r[0] currently holds R1
+    bool swapped = false;
+    for(bit--; bit >= 0; bit--) {
+        bool b = (k[bit / bits_in_digit] >> (bit % bits_in_digit)) & 1;
+
+        // r[0] = Rb, r[1] = R(1-b)
+        conditional_swap(r[0], r[1], b ^ swapped);
+
+        // (r[0], r[1]) = (Rb + R(1-b), Rb - R(1-b)), then (r[0], r[1]) = (Rb + R(1-b), 2 * Rb)
+        co_z_add_conjugate(r[0], r[1]);
+        co_z_add(r[0], r[1]);
+
+        swapped = !b;
+    }
+    conditional_swap(r[0], r[1], swapped);
+
+    // Bring R0 to z' = z * (X1 - X0) and compute R0 - R1 = -this on the way
+    Coordinate A(r[1].x), B, C, E, F, X, Y;
+    A -= r[0].x; A.square();
+    B = r[0].x; B *= A;
+    C = r[1].x; C *= A;
+    E = C; E -= B; E *= r[0].y;
+
+    F = r[0].y; F += r[1].y;
+    X = F; X.square(); X -= B; X -= C;
+    Y = X; Y -= B; Y *= F; Y -= E;
+
+    // (X, Y) is -this at z', so z' = -Y * this.x / (X * this.y) and R0 = (B * N^2, E * N^3, -Y * this.x) with N = X * this.y
+    X *= y;
+    Y *= x;
+    A = X; A.square();
+    x = B; x *= A;
+    A *= X;
+    y = E; y *= A;
+    z = 0; z -= Y;
+}
+
+// (p, q) = (p, p + q), with p brought to the z of the sum
+void Diffie_Hellman::Jacobian_Point::co_z_add(Jacobian_Point & p, Jacobian_Point & q)
+{
+    Coordinate A(q.x), D(q.y);
+
+    D -= p.y;
+    A -= p.x; A.square();
+    p.x *= A;
+    q.x *= A;
+    A = q.x; A -= p.x;
+    p.y *= A;
+
+    A = D; A.square();
+    A -= p.x; A -= q.x;
+
+    q.y = p.x; q.y -= A; q.y *= D;
+    q.y -= p.y;
+    q.x = A;
+}
+
+// (p, q) = (p + q, p - q), both at the same new z
+void Diffie_Hellman::Jacobian_Point::co_z_add_conjugate(Jacobian_Point & p, Jacobian_Point & q)
+{
+    Coordinate A(q.x), B(p.x), D(q.y), F(q.y), E;
+
+    D -= p.y; F += p.y;
+    A -= p.x; A.square();
+    B *= A;
+    q.x *= A;
+    E = q.x; E -= B; E *= p.y;
+
+    p.x = D; p.x.square();
+    p.x -= B; p.x -= q.x;
+    p.y = B; p.y -= p.x; p.y *= D;
+    p.y -= E;
+
+    A = F; A.square();
+    A -= B; A -= q.x;
+    q.y = A; q.y -= B; q.y *= F;
+    q.y -= E;
+    q.x = A;
+}
+
+void Diffie_Hellman::Jacobian_Point::jacobian_double()
 {
     Coordinate B, C(x), aux(z);
 
-    aux *= z; C -= aux;
+    aux.square(); C -= aux;
     aux += x; C *= aux;
-    C *= 3;
+    aux = C; C += aux; C += aux;
 
-    z *= y; z *= 2;
+    z *= y; z += z;
 
-    y *= y; B = y;
+    y.square(); B = y;
 
-    y *= x; y *= 4;
+    y *= x; y += y; y += y;
 
-    B *= B; B *= 8;
+    B.square(); B += B; B += B; B += B;
 
-    x = C; x *= x;
-    aux = y; aux *= 2;
+    x = C; x.square();
+    aux = y; aux += y;
     x -= aux;
 
     y -= x; y *= C;
     y -= B;
 }
 
-void Diffie_Hellman::Elliptic_Curve_Point::add_jacobian_affine(const Elliptic_Curve_Point &b)
+void Diffie_Hellman::Jacobian_Point::add_jacobian_affine(const Jacobian_Point &b)
 {
     Coordinate A(z), B, C, X, Y, aux, aux2;
 
-    A *= z;
+    A.square();
 
     B = A;
 
@@ -210,13 +596,13 @@ void Diffie_Hellman::Elliptic_Curve_Point::add_jacobian_affine(const Elliptic_Cu
 
     B -= y;
 
-    X = B; X *= B;
-    aux = C; aux *= C;
+    X = B; X.square();
+    aux = C; aux.square();
 
     Y = aux;
 
     aux2 = aux; aux *= C;
-    aux2 *= 2; aux2 *= x;
+    aux2 += aux2; aux2 *= x;
     aux += aux2; X -= aux;
 
     aux = Y; Y *= x;
@@ -229,4 +615,32 @@ void Diffie_Hellman::Elliptic_Curve_Point::add_jacobian_affine(const Elliptic_Cu
     x = X; y = Y;
 }
 
-__END_SYS
\ No newline at end of file
+void Diffie_Hellman::Jacobian_Point::add_jacobian(const Jacobian_Point &b)
+{
+    Coordinate Z1Z1(z), Z2Z2(b.z), U1(x), U2(b.x), S1(y), S2(b.y), H, R, aux;
+
+    Z1Z1.square(); Z2Z2.square();
+
+    U1 *= Z2Z2; U2 *= Z1Z1;
+
+    S1 *= b.z; S1 *= Z2Z2;
+    S2 *= z; S2 *= Z1Z1;
+
+    H = U2; H -= U1;
+    R = S2; R -= S1;
+
+    z *= b.z; z *= H;
+
+    aux = H; aux.square();
+    U1 *= aux;
+    aux *= H;
+    S1 *= aux;
+
+    x = R; x.square();
+    x -= aux; x -= U1; x -= U1;
+
+    y = U1; y -= x; y *= R;
+    y -= S1;
+}
+
+__END_SYS
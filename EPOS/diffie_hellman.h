@@ -17,30 +17,72 @@ public:
 
 private:
     typedef _UTIL::Bignum<SECRET_SIZE> Bignum;
+    typedef IF<Traits<Diffie_Hellman>::FIELD == Traits<Diffie_Hellman>::MONTGOMERY, _UTIL::Montgomery_Bignum<SECRET_SIZE>, Bignum>::Result Field;
+
+	class Jacobian_Point;
 
 	class Elliptic_Curve_Point
 	{
     public:
         typedef Diffie_Hellman::Bignum Coordinate;
 
-		Elliptic_Curve_Point() __attribute__((noinline)) { }
+		Elliptic_Curve_Point() __DEBUG_NOINLINE { }
 		Elliptic_Curve_Point(const Coordinate & _x, const Coordinate & _y) { x = _x; y = _y; z = 1; }
 
 		void operator*=(const Coordinate & b);
 
+		// Leaves the Field representation and goes back to affine coordinates
+		void operator=(const Jacobian_Point & p);
+
 		friend Debug &operator<<(Debug &out, const Elliptic_Curve_Point &a) {
 			out << "{x=" << a.x << ",y=" << a.y << ",z=" << a.z << "}";
 			return out;
 		}
 
-	private:
+    public:
+        Coordinate x, y, z = 1; // z = 1 means affine coordinates
+	};
+
+	// Working copy of an Elliptic_Curve_Point during point multiplication, in the representation given by Field
+	class Jacobian_Point
+	{
+    public:
+        typedef Diffie_Hellman::Field Coordinate;
+
+		Jacobian_Point() { }
+		Jacobian_Point(const Elliptic_Curve_Point & p): x(p.x), y(p.y), z(p.z) { }
+
+		static const Bignum & bignum(const Bignum & c) { return c; }
+		static Bignum bignum(const _UTIL::Montgomery_Bignum<SECRET_SIZE> & c) { return c.bignum(); }
+
+		// this = k * this, for k != 0 (see Traits<Diffie_Hellman>::MULTIPLICATION)
+		void multiply(const Bignum & k);
+		void binary_multiply(const Bignum & k);
+		void window_multiply(const Bignum & k);
+		void ladder_multiply(const Bignum & k);
+
 		void jacobian_double();
-		void add_jacobian_affine(const Elliptic_Curve_Point &b);
+		void add_jacobian_affine(const Jacobian_Point &b);
+		void add_jacobian(const Jacobian_Point &b);
+
+		void conditional_assign(const Jacobian_Point & b, bool condition);
+		static void conditional_swap(Jacobian_Point & a, Jacobian_Point & b, bool condition);
+		void select(const Jacobian_Point * odd_multiples, unsigned int entries, int digit);
+		void normalize();
+
+		static bool recode(int * digits, const Bignum & k, unsigned int w);
+
+		// Co-Z additions for points sharing the same z, which is left implicit (see ladder_multiply)
+		static void co_z_add(Jacobian_Point & p, Jacobian_Point & q);
+		static void co_z_add_conjugate(Jacobian_Point & p, Jacobian_Point & q);
 
     public:
-        Coordinate x, y, z = 1; // z = 1 means affine coordinates
+        Coordinate x, y, z;
 	};
 
+	// Odd multiples of the default base point for every window of a scalar (see Traits<Diffie_Hellman>::GENERATOR_TABLE)
+	class Generator_Table;
+
 public:
     typedef Elliptic_Curve_Point Public_Key;
     typedef Bignum Shared_Key;
@@ -54,6 +96,8 @@ public:
 
 	Shared_Key shared_key(Elliptic_Curve_Point public_key);
 	static Shared_Key shared_key(Elliptic_Curve_Point public_key, Bignum priv_key);
+	// shared_keys[i] = shared_key(public_keys[i], private_keys[i]), sharing one modular inversion among up to Traits<Diffie_Hellman>::BATCH_SIZE keys
+	static void shared_keys(const Public_Key * public_keys, const Private_Key * private_keys, Shared_Key * shared_keys, size_t n);
 	static bool is_valid_point(const Elliptic_Curve_Point& point);
 
 private:
@@ -65,12 +109,21 @@ private:
 		db<Diffie_Hellman>(INF) << "Diffie_Hellman Private: " << _private << std::endl;
 		db<Diffie_Hellman>(INF) << "Diffie_Hellman Base Point: " << _base_point << std::endl;
 
-		_public = _base_point;
-		_public *= _private;
+		if(Traits<Diffie_Hellman>::GENERATOR_TABLE && (_base_point.z == Bignum(1))
+			&& (_base_point.x == Bignum(_default_base_point_x, SECRET_SIZE)) && (_base_point.y == Bignum(_default_base_point_y, SECRET_SIZE)))
+			generator_multiply(_public, _private);
+		else {
+			_public = _base_point;
+			_public *= _private;
+		}
 
 		db<Diffie_Hellman>(INF) << "Diffie_Hellman Public: " << _public << std::endl;
 	}
 
+	// p = k * default base point
+	static void generator_multiply(Elliptic_Curve_Point & p, const Bignum & k);
+	static const Generator_Table & generator_table();
+
 private:
 	Private_Key _private;
 	Elliptic_Curve_Point _base_point;
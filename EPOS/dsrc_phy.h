@@ -8,6 +8,7 @@
 #include <omnetpp.h>
 #include "buffer.h"
 #include "observer.h"
+#include "random.h"
 
 __BEGIN_SYS
 
@@ -146,10 +147,10 @@ public:
         Header() {}
 
         Header(const Type & type)
-        : _frame_control(type), _sequence_number(uniform(0, 4294967295)), _dst_pan_id(PAN_ID_BROADCAST) {};
+        : _frame_control(type), _sequence_number(Random::random()), _dst_pan_id(PAN_ID_BROADCAST) {};
 
         Header(const Type & type, const Address & src, const Address & dst)
-        : _frame_control(type), _sequence_number(uniform(0, 4294967295)), _dst_pan_id(PAN_ID_BROADCAST), _dst(dst), _src(src) { ack_request(dst != broadcast()); }
+        : _frame_control(type), _sequence_number(Random::random()), _dst_pan_id(PAN_ID_BROADCAST), _dst(dst), _src(src) { ack_request(dst != broadcast()); }
 
         const Address & src() const { return _src; }
         const Address & dst() const { return _dst; }
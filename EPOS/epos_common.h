@@ -3,7 +3,6 @@
 
 #include <iostream>
 #include <cassert>
-#include <random>
 #include "meta.h"
 #include "traits.h"
 #include <climits>
@@ -19,48 +18,48 @@ enum Debug_Warning {WRN = 2};
 enum Debug_Info {INF = 3};
 enum Debug_Trace {TRC = 4};
 
-class Null_Streambuf : public std::streambuf
+// Stream db() returns for components whose Traits are not debugged: insertions compile to nothing, so discarded
+// messages are never formatted and loops that only build them are optimized away
+class Null_Stream
 {
-protected:
-    virtual int overflow(int c) {
-        setp(_dummy_buffer, _dummy_buffer + sizeof(_dummy_buffer));
-        return (c == EOF) ? '\0' : c;
-    }
-private:
-    char _dummy_buffer[64];
+public:
+    template<typename T>
+    Null_Stream & operator<<(const T &) { return *this; }
+    Null_Stream & operator<<(std::ostream & (*)(std::ostream &)) { return *this; } // std::endl
 };
 
-class Null_Stream : public Null_Streambuf, public std::ostream
+template<bool debugged>
+struct Debug_Stream
 {
-public:
-    Null_Stream() : std::ostream(this) { }
+    typedef std::ostream Type;
+    static Type & stream() { return std::cout; }
 };
 
-template<typename T, typename L>
-inline std::ostream & db(const L & l) {
-    if(Traits<T>::debugged)
-        return std::cout;
-    else {
+template<>
+struct Debug_Stream<false>
+{
+    typedef Null_Stream Type;
+    static Type & stream() {
         static Null_Stream _null_stream;
         return _null_stream;
     }
+};
+
+template<typename T, typename L>
+inline typename Debug_Stream<Traits<T>::debugged>::Type & db(const L & l) {
+    return Debug_Stream<Traits<T>::debugged>::stream();
 }
 
 typedef std::ostream OStream;
 typedef std::ostream Debug;
 
-class Random
-{
-public:
-    static int random() { 
-        std::random_device dev;
-        std::mt19937 rng(dev());
-
-        std::uniform_int_distribution<std::mt19937::result_type> dist(0,INT_MAX);
-
-        return dist(rng);
-    }
-};
+// Debug builds keep the arithmetic primitives out of line, so each call shows up in traces and profiles.
+// Production builds (-DEPOS_PRODUCTION) let the compiler inline them and unroll their loops over DIGITS.
+#ifdef EPOS_PRODUCTION
+#define __DEBUG_NOINLINE
+#else
+#define __DEBUG_NOINLINE __attribute__((noinline))
+#endif
 
 class CPU
 {
@@ -8,6 +8,8 @@
 #include <omnetpp.h>
 #include "buffer.h"
 #include "observer.h"
+#include "random.h"
+#include "cipher.h"
 
 __BEGIN_SYS
 
@@ -144,10 +146,10 @@ public:
         Header() {}
 
         Header(const Type & type)
-        : _frame_control(type), _sequence_number(uniform(0, 4294967295)), _dst_pan_id(PAN_ID_BROADCAST) {};
+        : _frame_control(type), _sequence_number(Random::random()), _dst_pan_id(PAN_ID_BROADCAST) {};
 
         Header(const Type & type, const Address & src, const Address & dst)
-        : _frame_control(type), _sequence_number(uniform(0, 4294967295)), _dst_pan_id(PAN_ID_BROADCAST), _dst(dst), _src(src) { ack_request(dst != broadcast()); }
+        : _frame_control(type), _sequence_number(Random::random()), _dst_pan_id(PAN_ID_BROADCAST), _dst(dst), _src(src) { ack_request(dst != broadcast()); }
 
         const Address & src() const { return _src; }
         const Address & dst() const { return _dst; }
@@ -194,6 +196,19 @@ public:
         template<typename T>
         T * data() { return reinterpret_cast<T *>(&_data); }
 
+        // Frame security (CCM*): the header is authenticated, the first size bytes of data are encrypted in place
+        // and the mic_size-byte MIC follows them, so size + mic_size bytes of data go on the air
+        void encrypt(const Cipher::Key_Schedule & key, const unsigned char * nonce, unsigned int size, unsigned int mic_size) {
+            assert(size + mic_size <= MTU);
+            _frame_control.se(true);
+            Cipher::ccm_encrypt(key, nonce, header(), sizeof(Header), _data, size, &_data[size], mic_size);
+        }
+        // size excludes the MIC; a frame that does not authenticate gets its data zeroed
+        bool decrypt(const Cipher::Key_Schedule & key, const unsigned char * nonce, unsigned int size, unsigned int mic_size) {
+            assert(size + mic_size <= MTU);
+            return Cipher::ccm_decrypt(key, nonce, header(), sizeof(Header), _data, size, &_data[size], mic_size);
+        }
+
         friend std::ostream & operator<<(std::ostream & db, const Frame & f) {
             db << "{h=" << reinterpret_cast<const Header &>(f) << ",d=" << f._data << "}";
             return db;
@@ -259,6 +274,17 @@ protected:
 public:
     static const unsigned int mtu() { return Frame::MTU; }
     static const Address broadcast() { return Address::BROADCAST; }
+
+    // CCM* nonce of a secured frame (802.15.4-2006 7.6.3.2): source extended address, frame counter and security level
+    static void nonce(unsigned char * n, const Extended_Address & src, unsigned long frame_counter, unsigned char level) {
+        for(unsigned int i = 0; i < sizeof(Extended_Address); i++)
+            n[i] = src[i];
+        n[8] = frame_counter >> 24;
+        n[9] = frame_counter >> 16;
+        n[10] = frame_counter >> 8;
+        n[11] = frame_counter;
+        n[12] = level;
+    }
 };
 
 __END_SYS
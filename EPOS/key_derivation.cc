@@ -0,0 +1,87 @@
+// EPOS Session Key Derivation Component Implementation
+
+#include "key_derivation.h"
+
+__BEGIN_SYS
+
+// Class methods
+void Key_Derivation::derive(const Shared_Key & secret, const unsigned char * context, unsigned int context_size, Direction_Keys keys[2])
+{
+    db<Key_Derivation>(TRC) << "Key_Derivation::derive(context_size=" << context_size << ")" << std::endl;
+
+    assert(context_size <= MAX_CONTEXT_SIZE);
+
+    // The bytes of the shared key, least significant first (as Bignum(bytes, len) reads them)
+    unsigned char ikm[KEY_SIZE];
+    for(unsigned int i = 0; i < KEY_SIZE; i++)
+        ikm[i] = secret[i / sizeof(Shared_Key::Digit)] >> (8 * (i % sizeof(Shared_Key::Digit)));
+    Cipher::Key_Schedule key(ikm, false);
+    Cipher ecb;
+
+    // CMAC subkey K1 = dbl(AES(secret, 0)), or K2 = dbl(K1) if the last block of input is padded
+    unsigned char subkey[KEY_SIZE] = {};
+    ecb.encrypt(subkey, key, subkey);
+    dbl(subkey, subkey);
+
+    // Input of every key block but the counter (byte 0, XORed into each chain apart), padded and masked with the subkey
+    const unsigned int size = 5 + context_size;
+    const unsigned int blocks = (size + KEY_SIZE - 1) / KEY_SIZE;
+    unsigned char input[4 * KEY_SIZE];
+    input[0] = 0;
+    input[1] = LABEL;
+    input[2] = 0;
+    if(context_size)
+        std::memcpy(&input[3], context, context_size);
+    input[3 + context_size] = (BLOCKS * KEY_SIZE * 8) >> 8;
+    input[4 + context_size] = (BLOCKS * KEY_SIZE * 8) & 0xff;
+    if(size % KEY_SIZE) {
+        input[size] = 0x80;
+        std::memset(&input[size + 1], 0, blocks * KEY_SIZE - size - 1);
+        dbl(subkey, subkey);
+    }
+    for(unsigned int i = 0; i < KEY_SIZE; i++)
+        input[(blocks - 1) * KEY_SIZE + i] ^= subkey[i];
+
+    // The CMAC chains of all BLOCKS counters advance together, one ECB call per block of input
+    unsigned char x[BLOCKS][KEY_SIZE];
+    std::memset(x, 0, sizeof(x));
+    for(unsigned int j = 0; j < blocks; j++) {
+        for(unsigned int i = 0; i < BLOCKS; i++)
+            for(unsigned int b = 0; b < KEY_SIZE; b++)
+                x[i][b] ^= input[j * KEY_SIZE + b];
+        if(j == 0)
+            for(unsigned int i = 0; i < BLOCKS; i++)
+                x[i][0] ^= i + 1;
+        ecb.encrypt(x, sizeof(x), key, &x[0][0], 0);
+    }
+
+    std::memcpy(keys, x, sizeof(x));
+
+    std::memset(ikm, 0, sizeof(ikm));
+    std::memset(x, 0, sizeof(x));
+}
+
+void Session_Keys::derive(const Shared_Key & secret, const Role & role, const unsigned char * context, unsigned int context_size)
+{
+    db<Session_Keys>(TRC) << "Session_Keys::derive(role=" << role << ",context_size=" << context_size << ")" << std::endl;
+
+    Key_Derivation::Direction_Keys keys[2];
+    Key_Derivation::derive(secret, context, context_size, keys);
+
+    const Key_Derivation::Direction_Keys & tx = keys[role];
+    const Key_Derivation::Direction_Keys & rx = keys[1 - role];
+
+    _tx.encryption.expand(tx.encryption, false);
+    _tx.mac.k(tx.mac_k);
+    _tx.mac.r(tx.mac_r);
+    _tx.otp.expand(tx.otp, false);
+
+    _rx.encryption.expand(rx.encryption);
+    _rx.mac.k(rx.mac_k);
+    _rx.mac.r(rx.mac_r);
+    _rx.otp.expand(rx.otp, false);
+
+    std::memset(keys, 0, sizeof(keys));
+}
+
+__END_SYS
@@ -0,0 +1,85 @@
+// EPOS Session Key Derivation Component Declarations
+
+#ifndef __key_derivation_h
+#define __key_derivation_h
+
+#include "diffie_hellman.h"
+#include "poly1305.h"
+
+__BEGIN_SYS
+
+// NIST SP 800-108 counter mode KDF with AES-CMAC (NIST SP 800-38B) as PRF, keyed with a Diffie_Hellman::Shared_Key:
+// key block i (from 1) is CMAC(secret, [i]_8 || LABEL || 0x00 || context || [L]_16), L being the bits derived
+// The blocks only differ in the counter, so their CMAC chains go through the rounds together
+class Key_Derivation
+{
+public:
+    static const unsigned int KEY_SIZE = Cipher::KEY_SIZE;
+    static const unsigned int MAX_CONTEXT_SIZE = 4 * KEY_SIZE - 5; // context of at most four blocks of input
+    static const unsigned char LABEL = 0x01; // session keys
+
+    typedef Diffie_Hellman::Shared_Key Shared_Key;
+
+    // The peers of a session take opposite roles (e.g. by comparing their ids), so that one's sending keys
+    // are the other's receiving keys
+    enum Role { INITIATOR, RESPONDER };
+
+    // Raw keys of one direction of a session
+    struct Direction_Keys
+    {
+        unsigned char encryption[KEY_SIZE];
+        unsigned char mac_k[KEY_SIZE]; // Poly1305-AES k
+        unsigned char mac_r[KEY_SIZE]; // Poly1305-AES r
+        unsigned char otp[KEY_SIZE];
+    };
+
+    static const unsigned int BLOCKS = 2 * sizeof(Direction_Keys) / KEY_SIZE;
+
+    // keys[INITIATOR] protects initiator to responder traffic and keys[RESPONDER] the opposite direction
+    static void derive(const Shared_Key & secret, const unsigned char * context, unsigned int context_size, Direction_Keys keys[2]);
+
+private:
+    // CMAC subkey doubling in GF(2^128)
+    static void dbl(unsigned char out[KEY_SIZE], const unsigned char in[KEY_SIZE]) {
+        unsigned char carry = in[0] >> 7;
+        for(unsigned int i = 0; i < KEY_SIZE - 1; i++)
+            out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+        out[KEY_SIZE - 1] = (in[KEY_SIZE - 1] << 1) ^ (0x87 & -carry);
+    }
+};
+
+// Key bundle of a session with one peer: the shared key goes through Key_Derivation once, and each derived key
+// is installed where it is used (AES round keys, Poly1305 key and r powers), so messages only use the bundle
+class Session_Keys
+{
+public:
+    typedef Key_Derivation::Shared_Key Shared_Key;
+    typedef Key_Derivation::Role Role;
+
+    struct Direction
+    {
+        Cipher::Key_Schedule encryption;
+        Poly1305 mac;
+        Cipher::Key_Schedule otp;
+    };
+
+public:
+    Session_Keys() {}
+    Session_Keys(const Shared_Key & secret, const Role & role, const unsigned char * context = 0, unsigned int context_size = 0) {
+        derive(secret, role, context, context_size);
+    }
+
+    void derive(const Shared_Key & secret, const Role & role, const unsigned char * context = 0, unsigned int context_size = 0);
+
+    // Keys for what this node sends and for what it receives (only the latter get decryption round keys)
+    Direction & tx() { return _tx; }
+    Direction & rx() { return _rx; }
+
+private:
+    Direction _tx;
+    Direction _rx;
+};
+
+__END_SYS
+
+#endif
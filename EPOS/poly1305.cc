@@ -0,0 +1,137 @@
+// EPOS Poly1305-AES Message Authentication Code Component Implementation
+
+#include "poly1305.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define __poly1305_avx2
+#endif
+
+__BEGIN_SYS
+
+// Class methods
+unsigned int Poly1305::lanes()
+{
+#ifdef __poly1305_avx2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if(Traits<Poly1305>::SIMD && (Traits<Poly1305>::ENGINE == Traits<Poly1305>::RADIX_26) && avx2)
+        return LANES;
+#endif
+    return 1;
+}
+
+void Poly1305::verify(bool * results, const Poly1305 * keys, const unsigned char (* macs)[16], const unsigned char (* nonces)[16],
+                      const unsigned char * const * messages, const unsigned int * lengths, size_t n)
+{
+    db<Poly1305>(TRC) << "Poly1305::verify(n=" << n << ")" << std::endl;
+
+    for(size_t base = 0; base < n; base += LANES) {
+        unsigned int lanes = (n - base < LANES) ? n - base : LANES;
+
+        // Each lane works on a copy of its key, so the same key can show up more than once in a batch
+        Poly1305 lane[LANES];
+        Accumulator * accumulators[LANES];
+        const unsigned char * blocks[LANES];
+        unsigned int common = ~0U; // full blocks all lanes have
+        for(unsigned int i = 0; i < lanes; i++) {
+            lane[i] = keys[base + i];
+            lane[i].init(nonces[base + i]);
+            accumulators[i] = &lane[i]._accumulator;
+            blocks[i] = messages[base + i];
+            if(lengths[base + i] / BLOCK_SIZE < common)
+                common = lengths[base + i] / BLOCK_SIZE;
+        }
+
+        Accumulator::parallel_blocks(accumulators, blocks, lanes, common);
+
+        // The rest of each message goes through the scalar path
+        for(unsigned int i = 0; i < lanes; i++) {
+            unsigned int done = common * BLOCK_SIZE;
+            if(lengths[base + i] > done)
+                lane[i].update(&messages[base + i][done], lengths[base + i] - done);
+
+            unsigned char mac[16];
+            lane[i].finish(mac);
+            results[base + i] = equal(mac, macs[base + i]);
+        }
+    }
+}
+
+void Poly1305::Radix_26_Accumulator::parallel_blocks(Radix_26_Accumulator * a[], const unsigned char * c[], unsigned int lanes, unsigned int n)
+{
+#ifdef __poly1305_avx2
+    if((lanes == LANES) && (Poly1305::lanes() == LANES)) {
+        avx2_blocks(a, c, n);
+        return;
+    }
+#endif
+
+    for(unsigned int i = 0; i < lanes; i++)
+        a[i]->blocks(c[i], n, true);
+}
+
+#ifdef __poly1305_avx2
+
+// The same steps as Radix_26_Accumulator::blocks() without R_POWERS, with lane i of each 256-bit register holding a limb of a[i]
+__attribute__((target("avx2")))
+void Poly1305::Radix_26_Accumulator::avx2_blocks(Radix_26_Accumulator * a[LANES], const unsigned char * c[LANES], unsigned int n)
+{
+    const __m256i mask = _mm256_set1_epi64x(MASK);
+    const __m256i hibit = _mm256_set1_epi64x(1 << 24); // 2^128
+
+    __m256i r[5], s[5], h[5];
+    for(unsigned int i = 0; i < 5; i++) {
+        r[i] = _mm256_set_epi64x(a[3]->_r[0][i], a[2]->_r[0][i], a[1]->_r[0][i], a[0]->_r[0][i]);
+        s[i] = _mm256_set_epi64x(a[3]->_s[0][i], a[2]->_s[0][i], a[1]->_s[0][i], a[0]->_s[0][i]);
+        h[i] = _mm256_set_epi64x(a[3]->_h[i], a[2]->_h[i], a[1]->_h[i], a[0]->_h[i]);
+    }
+
+    const unsigned char * c0 = c[0], * c1 = c[1], * c2 = c[2], * c3 = c[3];
+    for(; n > 0; n--, c0 += BLOCK_SIZE, c1 += BLOCK_SIZE, c2 += BLOCK_SIZE, c3 += BLOCK_SIZE) {
+        // lo and hi get bytes 0-7 and 8-15 of each lane's block
+        __m256i t0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(c0))),
+                                             _mm_loadu_si128(reinterpret_cast<const __m128i *>(c2)), 1);
+        __m256i t1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(c1))),
+                                             _mm_loadu_si128(reinterpret_cast<const __m128i *>(c3)), 1);
+        __m256i lo = _mm256_unpacklo_epi64(t0, t1);
+        __m256i hi = _mm256_unpackhi_epi64(t0, t1);
+
+        h[0] = _mm256_add_epi64(h[0], _mm256_and_si256(lo, mask));
+        h[1] = _mm256_add_epi64(h[1], _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask));
+        h[2] = _mm256_add_epi64(h[2], _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52), _mm256_slli_epi64(hi, 12)), mask));
+        h[3] = _mm256_add_epi64(h[3], _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask));
+        h[4] = _mm256_add_epi64(h[4], _mm256_or_si256(_mm256_srli_epi64(hi, 40), hibit));
+
+        // d[i] = sum of h[j] * r[i - j], with s = 5 * r standing for the products that wrap around 2^130
+        __m256i d[5];
+        for(unsigned int i = 0; i < 5; i++) {
+            d[i] = _mm256_mul_epu32(h[0], r[i]);
+            for(unsigned int j = 1; j < 5; j++)
+                d[i] = _mm256_add_epi64(d[i], _mm256_mul_epu32(h[j], (j <= i) ? r[i - j] : s[5 + i - j]));
+        }
+
+        // Partial carry propagation
+        __m256i carry;
+        carry = _mm256_srli_epi64(d[0], 26); d[0] = _mm256_and_si256(d[0], mask);
+        for(unsigned int i = 1; i < 5; i++) {
+            d[i] = _mm256_add_epi64(d[i], carry);
+            carry = _mm256_srli_epi64(d[i], 26);
+            h[i] = _mm256_and_si256(d[i], mask);
+        }
+        d[0] = _mm256_add_epi64(d[0], _mm256_add_epi64(carry, _mm256_slli_epi64(carry, 2)));
+        carry = _mm256_srli_epi64(d[0], 26);
+        h[0] = _mm256_and_si256(d[0], mask);
+        h[1] = _mm256_add_epi64(h[1], carry);
+    }
+
+    for(unsigned int i = 0; i < 5; i++) {
+        alignas(32) unsigned long long limbs[LANES];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(limbs), h[i]);
+        for(unsigned int l = 0; l < LANES; l++)
+            a[l]->_h[i] = limbs[l];
+    }
+}
+
+#endif
+
+__END_SYS
@@ -14,46 +14,333 @@ class Poly1305
 {
     typedef _UTIL::Bignum<17> Bignum;
 
+    static const unsigned int BLOCK_SIZE = 16;
+    static const unsigned int LANES = 4; // messages evaluated side by side in batch verification
+
+    // h = (h + c) * r % (2^130 - 5) for each message block c, with the generic Bignum<17> arithmetic
+    class Bignum_Accumulator
+    {
+    public:
+        void key(const Bignum & r) { _r = r; }
+        void reset() { _h = 0; }
+
+        // c holds BLOCK_SIZE bytes; full blocks get 2^128 added, a padded last block already carries its 1 byte
+        void blocks(const unsigned char * c, unsigned int n, bool full) {
+            for(; n > 0; n--, c += BLOCK_SIZE) {
+                Bignum b(c, BLOCK_SIZE);
+                if(full)
+                    reinterpret_cast<unsigned char *>(b._data)[BLOCK_SIZE] = 1;
+
+                _h += b;
+                _h *= _r;
+            }
+        }
+
+        // out = h % 2^128
+        void value(unsigned char out[16]) const { std::memcpy(out, _h._data, 16); }
+
+        // a[i]->blocks(c[i], n, true) for each of the given lanes
+        static void parallel_blocks(Bignum_Accumulator * a[], const unsigned char * c[], unsigned int lanes, unsigned int n) {
+            for(unsigned int i = 0; i < lanes; i++)
+                a[i]->blocks(c[i], n, true);
+        }
+
+    private:
+        Bignum _r;
+        Bignum _h;
+    };
+
+    // Same as Bignum_Accumulator, with h and r in radix 2^26 (h = h0 + h1 * 2^26 + ... + h4 * 2^104)
+    class Radix_26_Accumulator
+    {
+    private:
+        static const unsigned int MASK = 0x3ffffff;
+        static const unsigned int POWERS = Traits<Poly1305>::R_POWERS ? 4 : 1;
+
+        typedef unsigned int Limbs[5];
+        typedef unsigned long long Products[5];
+
+    public:
+        // _r[i] = r^(i + 1)
+        void key(const Bignum & r) {
+            load(_r[0], reinterpret_cast<const unsigned char *>(r._data), 0);
+            wrap(_s[0], _r[0]);
+
+            for(unsigned int i = 1; i < POWERS; i++) {
+                Products d = {0, 0, 0, 0, 0};
+                multiply_add(d, _r[i - 1], _r[0], _s[0]);
+                carry(_r[i], d);
+                wrap(_s[i], _r[i]);
+            }
+        }
+
+        void reset() {
+            for(unsigned int i = 0; i < 5; i++)
+                _h[i] = 0;
+        }
+
+        void blocks(const unsigned char * c, unsigned int n, bool full) {
+            const unsigned int hibit = full ? (1 << 24) : 0; // 2^128
+
+            for(; (POWERS == 4) && (n >= 4); n -= 4, c += 4 * BLOCK_SIZE) {
+                Limbs c1, c2, c3, c4;
+                load(c1, &c[0], hibit);
+                load(c2, &c[BLOCK_SIZE], hibit);
+                load(c3, &c[2 * BLOCK_SIZE], hibit);
+                load(c4, &c[3 * BLOCK_SIZE], hibit);
+                for(unsigned int i = 0; i < 5; i++)
+                    c1[i] += _h[i];
+
+                Products d = {0, 0, 0, 0, 0};
+                multiply_add(d, c1, _r[3], _s[3]);
+                multiply_add(d, c2, _r[2], _s[2]);
+                multiply_add(d, c3, _r[1], _s[1]);
+                multiply_add(d, c4, _r[0], _s[0]);
+                carry(_h, d);
+            }
+
+            for(; n > 0; n--, c += BLOCK_SIZE) {
+                Limbs c1;
+                load(c1, c, hibit);
+                for(unsigned int i = 0; i < 5; i++)
+                    c1[i] += _h[i];
+
+                Products d = {0, 0, 0, 0, 0};
+                multiply_add(d, c1, _r[0], _s[0]);
+                carry(_h, d);
+            }
+        }
+
+        // out = (h % (2^130 - 5)) % 2^128
+        void value(unsigned char out[16]) const {
+            unsigned int h0 = _h[0], h1 = _h[1], h2 = _h[2], h3 = _h[3], h4 = _h[4];
+
+            // Full carry propagation
+            unsigned int carry;
+            carry = h1 >> 26; h1 &= MASK;
+            h2 += carry; carry = h2 >> 26; h2 &= MASK;
+            h3 += carry; carry = h3 >> 26; h3 &= MASK;
+            h4 += carry; carry = h4 >> 26; h4 &= MASK;
+            h0 += carry * 5; carry = h0 >> 26; h0 &= MASK;
+            h1 += carry;
+
+            // g = h - (2^130 - 5); take it instead of h if it did not borrow, without branching
+            unsigned int g0, g1, g2, g3, g4;
+            g0 = h0 + 5; carry = g0 >> 26; g0 &= MASK;
+            g1 = h1 + carry; carry = g1 >> 26; g1 &= MASK;
+            g2 = h2 + carry; carry = g2 >> 26; g2 &= MASK;
+            g3 = h3 + carry; carry = g3 >> 26; g3 &= MASK;
+            g4 = h4 + carry - (1 << 26);
+
+            unsigned int select = (g4 >> 31) - 1;
+            h0 = (h0 & ~select) | (g0 & select);
+            h1 = (h1 & ~select) | (g1 & select);
+            h2 = (h2 & ~select) | (g2 & select);
+            h3 = (h3 & ~select) | (g3 & select);
+            h4 = (h4 & ~select) | (g4 & select);
+
+            store32(&out[0], h0 | (h1 << 26));
+            store32(&out[4], (h1 >> 6) | (h2 << 20));
+            store32(&out[8], (h2 >> 12) | (h3 << 14));
+            store32(&out[12], (h3 >> 18) | (h4 << 8));
+        }
+
+        // a[i]->blocks(c[i], n, true) for each of the given lanes, with AVX2 if there are LANES of them (see Traits<Poly1305>::SIMD)
+        static void parallel_blocks(Radix_26_Accumulator * a[], const unsigned char * c[], unsigned int lanes, unsigned int n);
+
+    private:
+        static void load(Limbs c, const unsigned char * block, unsigned int hibit) {
+            c[0] = load32(&block[0]) & MASK;
+            c[1] = (load32(&block[3]) >> 2) & MASK;
+            c[2] = (load32(&block[6]) >> 4) & MASK;
+            c[3] = (load32(&block[9]) >> 6) & MASK;
+            c[4] = (load32(&block[12]) >> 8) | hibit;
+        }
+
+        // 2^130 = 5 (mod 2^130 - 5), so the limbs that overflow 2^130 wrap around multiplied by 5
+        static void wrap(Limbs s, const Limbs r) {
+            for(unsigned int i = 0; i < 5; i++)
+                s[i] = r[i] * 5;
+        }
+
+        // d += h * r, with s = 5 * r
+        static void multiply_add(Products d, const Limbs h, const Limbs r, const Limbs s) {
+            d[0] += mul(h[0], r[0]) + mul(h[1], s[4]) + mul(h[2], s[3]) + mul(h[3], s[2]) + mul(h[4], s[1]);
+            d[1] += mul(h[0], r[1]) + mul(h[1], r[0]) + mul(h[2], s[4]) + mul(h[3], s[3]) + mul(h[4], s[2]);
+            d[2] += mul(h[0], r[2]) + mul(h[1], r[1]) + mul(h[2], r[0]) + mul(h[3], s[4]) + mul(h[4], s[3]);
+            d[3] += mul(h[0], r[3]) + mul(h[1], r[2]) + mul(h[2], r[1]) + mul(h[3], r[0]) + mul(h[4], s[4]);
+            d[4] += mul(h[0], r[4]) + mul(h[1], r[3]) + mul(h[2], r[2]) + mul(h[3], r[1]) + mul(h[4], r[0]);
+        }
+
+        // Partial carry propagation: limbs stay below 2^27, which is enough for the next products
+        // (the sum of four products reaches 2^59, so carries are kept in 64 bits)
+        static void carry(Limbs h, Products d) {
+            unsigned long long carry;
+            carry = d[0] >> 26; d[0] &= MASK;
+            d[1] += carry; carry = d[1] >> 26; h[1] = d[1] & MASK;
+            d[2] += carry; carry = d[2] >> 26; h[2] = d[2] & MASK;
+            d[3] += carry; carry = d[3] >> 26; h[3] = d[3] & MASK;
+            d[4] += carry; carry = d[4] >> 26; h[4] = d[4] & MASK;
+            d[0] += carry * 5; carry = d[0] >> 26; h[0] = d[0] & MASK;
+            h[1] += carry;
+        }
+
+        static unsigned long long mul(unsigned int a, unsigned int b) { return static_cast<unsigned long long>(a) * b; }
+
+        static void avx2_blocks(Radix_26_Accumulator * a[LANES], const unsigned char * c[LANES], unsigned int n);
+
+    private:
+        Limbs _r[POWERS];
+        Limbs _s[POWERS];
+        Limbs _h;
+    };
+
+    // The last Traits<Poly1305>::PAD_CACHE nonces and their pads, replaced in FIFO order
+    class Pad_Cache
+    {
+    private:
+        static const unsigned int ENTRIES = Traits<Poly1305>::PAD_CACHE ? Traits<Poly1305>::PAD_CACHE : 1;
+
+    public:
+        Pad_Cache(): _entries(0), _next(0) {}
+
+        bool get(const unsigned char nonce[16], unsigned char pad[16]) const {
+            for(unsigned int i = 0; i < _entries; i++)
+                if(!std::memcmp(_nonces[i], nonce, 16)) {
+                    std::memcpy(pad, _pads[i], 16);
+                    return true;
+                }
+            return false;
+        }
+
+        void put(const unsigned char nonce[16], const unsigned char pad[16]) {
+            std::memcpy(_nonces[_next], nonce, 16);
+            std::memcpy(_pads[_next], pad, 16);
+            _next = (_next + 1) % ENTRIES;
+            if(_entries < ENTRIES)
+                _entries++;
+        }
+
+        void clear() { _entries = 0; _next = 0; }
+
+    private:
+        unsigned int _entries;
+        unsigned int _next;
+        unsigned char _nonces[ENTRIES][16];
+        unsigned char _pads[ENTRIES][16];
+    };
+
+    typedef IF<Traits<Poly1305>::ENGINE == Traits<Poly1305>::RADIX_26, Radix_26_Accumulator, Bignum_Accumulator>::Result Accumulator;
+
 public:
     Poly1305(const unsigned char k[16], const unsigned char r[16]) : _k(k, 16), _r(r, 16) {
         clamp();
+        _accumulator.key(_r);
+        _schedule.expand(reinterpret_cast<const unsigned char *>(_k._data), false);
     }
     Poly1305() {}
 
     void stamp(unsigned char out[16], const unsigned char nonce[16], const unsigned char * message, int message_len) {
-        // cr = (c_1 * r^q + c_2 * r^(q-1) + ... + c_q * r^1) % (2^130 - 5)
-        Bignum cr(0);
-        for(; message_len > 0; message_len -= 16, message += 16) {
-            int len = (message_len < 16) ? message_len : 16;
-            Bignum c(message, len);
-            reinterpret_cast<unsigned char *>(c._data)[len] = 1;
+        init(nonce);
+        if(message_len > 0)
+            update(message, message_len);
+        finish(out);
+    }
+
+    bool verify(const unsigned char mac[16], const unsigned char nonce[16], const unsigned char * message, unsigned int message_len) {
+        unsigned char my_mac[16];
+        stamp(my_mac, nonce, message, message_len);
+        return equal(my_mac, mac);
+    }
+
+    // results[i] = keys[i].verify(macs[i], nonces[i], messages[i], lengths[i]), evaluating up to lanes() messages at a time
+    static void verify(bool * results, const Poly1305 * keys, const unsigned char (* macs)[16], const unsigned char (* nonces)[16],
+                       const unsigned char * const * messages, const unsigned int * lengths, size_t n);
+
+    // Number of messages batch verification evaluates side by side on this CPU
+    static unsigned int lanes();
 
-            cr += c;
-            cr *= _r;
+    // Incremental interface: init(nonce), then update() with each piece of the message, then finish(out)
+    // gives the same MAC as stamp(out, nonce, message, message_len), without gathering the pieces in one buffer
+    void init(const unsigned char nonce[16]) {
+        if(!Traits<Poly1305>::PAD_CACHE || !_pads.get(nonce, _pad)) {
+            Cipher cipher;
+            cipher.encrypt(nonce, _schedule, _pad);
+            if(Traits<Poly1305>::PAD_CACHE)
+                _pads.put(nonce, _pad);
         }
+        _accumulator.reset();
+        _buffered = 0;
+    }
+
+    void update(const void * data, unsigned int len) {
+        const unsigned char * message = reinterpret_cast<const unsigned char *>(data);
 
-        unsigned char ciphertext[16];
-        Cipher cipher;
-        cipher.encrypt(nonce, reinterpret_cast<const unsigned char *>(_k._data), ciphertext);
+        if(_buffered) {
+            unsigned int n = (len < BLOCK_SIZE - _buffered) ? len : BLOCK_SIZE - _buffered;
+            std::memcpy(&_buffer[_buffered], message, n);
+            _buffered += n;
+            message += n;
+            len -= n;
+            if(_buffered < BLOCK_SIZE)
+                return;
+            _accumulator.blocks(_buffer, 1, true);
+            _buffered = 0;
+        }
+
+        unsigned int blocks = len / BLOCK_SIZE;
+        if(blocks) {
+            _accumulator.blocks(message, blocks, true);
+            message += blocks * BLOCK_SIZE;
+            len -= blocks * BLOCK_SIZE;
+        }
 
-        // out = (cr + aes(k,n)) % 2^128
-        Bignum::simple_add(reinterpret_cast<Bignum::Digit *>(out), reinterpret_cast<const Bignum::Digit *>(ciphertext), cr._data, 4);
+        if(len) {
+            std::memcpy(_buffer, message, len);
+            _buffered = len;
+        }
     }
 
-    bool verify(const unsigned char mac[16], const unsigned char nonce[16], const unsigned char * message, unsigned int message_len) {
-        unsigned char my_mac[16];
-        stamp(my_mac, nonce, message, message_len);
-        for(int i = 0; i < 16; i++) {
-            if(my_mac[i] != mac[i])
-                return false;
+    void finish(unsigned char out[16]) {
+        if(_buffered) {
+            _buffer[_buffered] = 1;
+            for(unsigned int i = _buffered + 1; i < BLOCK_SIZE; i++)
+                _buffer[i] = 0;
+            _accumulator.blocks(_buffer, 1, false);
+            _buffered = 0;
+        }
+
+        // out = (cr + aes(k,n)) % 2^128, with cr = (c_1 * r^q + c_2 * r^(q-1) + ... + c_q * r^1) % (2^130 - 5)
+        unsigned char cr[16];
+        _accumulator.value(cr);
+
+        unsigned long long sum = 0;
+        for(unsigned int i = 0; i < 16; i += 4) {
+            sum += static_cast<unsigned long long>(load32(&cr[i])) + load32(&_pad[i]);
+            store32(&out[i], sum);
+            sum >>= 32;
         }
-        return true;
     }
 
-    void k(const unsigned char k1[16]) { new (&_k) Bignum(k1,16); }
-    void r(const unsigned char r1[16]) { new (&_r) Bignum(r1,16); clamp(); }
+    void k(const unsigned char k1[16]) { new (&_k) Bignum(k1,16); _schedule.expand(reinterpret_cast<const unsigned char *>(_k._data), false); _pads.clear(); }
+    void r(const unsigned char r1[16]) { new (&_r) Bignum(r1,16); clamp(); _accumulator.key(_r); }
 
 private:
+    // Constant time: all bytes are compared and the result is derived from their accumulated difference without branching
+    static bool equal(const unsigned char a[16], const unsigned char b[16]) {
+        unsigned int difference = 0;
+        for(int i = 0; i < 16; i++)
+            difference |= a[i] ^ b[i];
+        return ((difference - 1) >> 8) & 1;
+    }
+
+    static unsigned int load32(const unsigned char * p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<unsigned int>(p[3]) << 24);
+    }
+    static void store32(unsigned char * p, unsigned int v) {
+        p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+    }
+
     void clamp() {
         reinterpret_cast<unsigned char *>(_r._data)[3] &= 15;
         reinterpret_cast<unsigned char *>(_r._data)[7] &= 15;
@@ -66,6 +353,14 @@ private:
 
     Bignum _k;
     Bignum _r;
+    Cipher::Key_Schedule _schedule; // AES round keys of _k
+    Pad_Cache _pads;
+
+    // Incremental MAC state
+    Accumulator _accumulator;
+    unsigned char _pad[16];
+    unsigned char _buffer[BLOCK_SIZE];
+    unsigned int _buffered;
 };
 
 __END_SYS
@@ -0,0 +1,53 @@
+// EPOS Random Number Generator Implementation
+
+#include "random.h"
+#include <random>
+
+__BEGIN_SYS
+
+// Class attributes
+thread_local Random::DRBG Random::_drbg;
+
+// Class methods
+void Random::DRBG::seed()
+{
+    db<Random>(TRC) << "Random::DRBG::seed()" << std::endl;
+
+    std::random_device device;
+    unsigned char key[BLOCK_SIZE];
+    for(unsigned int i = 0; i < BLOCK_SIZE; i += sizeof(unsigned int)) {
+        unsigned int k = device();
+        unsigned int c = device();
+        std::memcpy(&key[i], &k, sizeof(unsigned int));
+        std::memcpy(&_counter[i], &c, sizeof(unsigned int));
+    }
+    _key.expand(key, false);
+    _seeded = true;
+}
+
+// output = AES(key, ++counter)
+void Random::DRBG::next_block(unsigned char * output)
+{
+    for(int i = BLOCK_SIZE - 1; (i >= 0) && !++_counter[i]; i--);
+    _cipher.encrypt(_counter, _key, output);
+}
+
+void Random::DRBG::generate(unsigned char * output, size_t size)
+{
+    if(!_seeded)
+        seed();
+
+    unsigned char block[BLOCK_SIZE];
+    for(; size >= BLOCK_SIZE; output += BLOCK_SIZE, size -= BLOCK_SIZE)
+        next_block(output);
+    if(size) {
+        next_block(block);
+        std::memcpy(output, block, size);
+    }
+
+    // Replace the key with fresh generator output, so earlier outputs cannot be recovered from the state
+    next_block(block);
+    _key.expand(block, false);
+}
+
+__END_SYS
@@ -0,0 +1,53 @@
+// EPOS Random Number Generator Declarations
+
+#ifndef __random_h
+#define __random_h
+
+#include "cipher.h"
+
+__BEGIN_SYS
+
+// Cryptographically secure pseudo-random numbers from an AES-CTR DRBG (in the spirit of NIST SP 800-90A CTR_DRBG,
+// without derivation function), built on Cipher. Each thread has its own generator, seeded once from
+// std::random_device on first use.
+class Random
+{
+private:
+    static const unsigned int BLOCK_SIZE = Cipher::KEY_SIZE;
+
+    class DRBG
+    {
+    public:
+        DRBG(): _seeded(false) {}
+
+        void generate(unsigned char * output, size_t size);
+
+    private:
+        void seed();
+        void next_block(unsigned char * output);
+
+    private:
+        bool _seeded;
+        Cipher _cipher;
+        Cipher::Key_Schedule _key;
+        unsigned char _counter[BLOCK_SIZE];
+    };
+
+public:
+    // Fills buffer with size random bytes
+    static void fill(void * buffer, size_t size) { _drbg.generate(reinterpret_cast<unsigned char *>(buffer), size); }
+
+    // Random number in [0, INT_MAX]
+    static int random() {
+        int r;
+        fill(&r, sizeof(int));
+        return r & INT_MAX;
+    }
+
+private:
+    static thread_local DRBG _drbg;
+};
+
+__END_SYS
+
+#endif
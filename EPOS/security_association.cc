@@ -0,0 +1,85 @@
+// EPOS Security Association Table Implementation
+
+#include "security_association.h"
+
+__BEGIN_SYS
+
+// Class methods
+Security_Association_Table::Security_Association_Table(): _size(0), _hits(0), _misses(0), _evictions(0)
+{
+    for(unsigned int i = 0; i < SIZE; i++)
+        _lru.insert_tail(&_associations[i]._lru);
+}
+
+Session_Keys * Security_Association_Table::search(const Node_ID & id)
+{
+    Security_Association * sa = lookup(id, Security_Association::key(id));
+
+    db<Security_Association_Table>(TRC) << "Security_Association_Table::search(id=" << id << ") => " << sa << std::endl;
+
+    if(!sa) {
+        _misses++;
+        return 0;
+    }
+
+    _hits++;
+    touch(sa);
+    return &sa->_keys;
+}
+
+Session_Keys & Security_Association_Table::insert(const Node_ID & id, const Shared_Key & secret, const Role & role, const unsigned char * context, unsigned int context_size)
+{
+    const Key key = Security_Association::key(id);
+    Security_Association * sa = lookup(id, key);
+
+    db<Security_Association_Table>(TRC) << "Security_Association_Table::insert(id=" << id << ",role=" << role << ") => " << (sa ? "rekey" : "new") << std::endl;
+
+    if(!sa) {
+        sa = _lru.head()->object();
+        if(sa->_used) {
+            _hash.remove(&sa->_link);
+            _evictions++;
+        } else
+            _size++;
+
+        sa->_id = id;
+        sa->_used = true;
+        sa->_link.rank(key);
+        _hash.insert(&sa->_link);
+    }
+
+    sa->_keys.derive(secret, role, context, context_size);
+    touch(sa);
+    return sa->_keys;
+}
+
+bool Security_Association_Table::remove(const Node_ID & id)
+{
+    db<Security_Association_Table>(TRC) << "Security_Association_Table::remove(id=" << id << ")" << std::endl;
+
+    Security_Association * sa = lookup(id, Security_Association::key(id));
+    if(!sa)
+        return false;
+
+    _hash.remove(&sa->_link);
+    sa->_used = false;
+    std::memset(static_cast<void *>(&sa->_keys), 0, sizeof(Session_Keys));
+    _size--;
+
+    // Back to the head, to be reused before any association in use
+    _lru.remove(&sa->_lru);
+    _lru.insert_head(&sa->_lru);
+
+    return true;
+}
+
+Security_Association * Security_Association_Table::lookup(const Node_ID & id, const Key & key)
+{
+    // Distinct ids may share a key, so the whole id is compared along the synonym list of the bucket
+    for(Security_Association::Element * e = _hash[key]->head(); e; e = e->next())
+        if((e->key() == key) && (e->object()->_id == id))
+            return e->object();
+    return 0;
+}
+
+__END_SYS
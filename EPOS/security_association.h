@@ -0,0 +1,111 @@
+// EPOS Security Association Table Declarations
+
+#ifndef __security_association_h
+#define __security_association_h
+
+#include "key_derivation.h"
+#include "array.h"
+#include "list.h"
+#include "hash.h"
+
+__BEGIN_SYS
+
+// Session with one peer, as established by the DH_REQUEST/DH_RESPONSE/AUTH_GRANTED handshake: the peer id and
+// the Session_Keys derived from the shared key (AES round keys and Poly1305 state already installed)
+class Security_Association
+{
+    friend class Security_Association_Table;
+
+public:
+    typedef _UTIL::Array<unsigned char, 16> Node_ID; // TSTP_Common::Node_ID
+    typedef unsigned int Key;
+
+    typedef _UTIL::List_Elements::Singly_Linked_Ordered<Security_Association, Key> Element;
+    typedef _UTIL::List_Elements::Doubly_Linked<Security_Association> LRU_Element;
+
+public:
+    Security_Association(): _used(false), _link(this), _lru(this) {}
+
+    const Node_ID & id() const { return _id; }
+    Session_Keys & keys() { return _keys; }
+
+    // Hash key of a node id: its four words folded and mixed (MurmurHash3 finalizer), so that ids differing
+    // in any byte spread over the buckets of Hash, which takes the key modulo the number of buckets
+    static Key key(const Node_ID & id) {
+        Key w[4];
+        std::memcpy(w, static_cast<const unsigned char *>(id), sizeof(w));
+        Key k = w[0] ^ w[1] ^ w[2] ^ w[3];
+        k ^= k >> 16;
+        k *= 0x85ebca6b;
+        k ^= k >> 13;
+        k *= 0xc2b2ae35;
+        k ^= k >> 16;
+        return k;
+    }
+
+private:
+    Node_ID _id;
+    Session_Keys _keys;
+    bool _used;
+    Element _link;
+    LRU_Element _lru;
+};
+
+// Bounded cache of Security_Associations indexed by peer Node_ID, so that the handshake (and its ECDH) runs once
+// per peer instead of once per exchange. Associations are preallocated and linked into a Hash (one synonym list
+// per bucket, keyed by Security_Association::key()) and into a list from least to most recently used, whose
+// head is reused when the table is full
+class Security_Association_Table
+{
+public:
+    static const unsigned int SIZE = Traits<Security_Association_Table>::SIZE;
+
+    typedef Security_Association::Node_ID Node_ID;
+    typedef Security_Association::Key Key;
+    typedef Session_Keys::Shared_Key Shared_Key;
+    typedef Session_Keys::Role Role;
+
+public:
+    Security_Association_Table();
+
+    // Keys of the session with id (which becomes the most recently used), or 0 if there is none,
+    // in which case the caller runs the handshake and insert()s its result
+    Session_Keys * search(const Node_ID & id);
+
+    // Derives the keys of the session with id from the shared key of the handshake, replacing those of a previous
+    // session with id or, if the table is full, the least recently used association
+    Session_Keys & insert(const Node_ID & id, const Shared_Key & secret, const Role & role, const unsigned char * context = 0, unsigned int context_size = 0);
+
+    // Forgets (and wipes) the session with id
+    bool remove(const Node_ID & id);
+
+    unsigned int size() const { return _size; }
+
+    unsigned long hits() const { return _hits; }
+    unsigned long misses() const { return _misses; }
+    unsigned long evictions() const { return _evictions; }
+
+private:
+    Security_Association * lookup(const Node_ID & id, const Key & key);
+
+    // Moves sa to the most recently used end
+    void touch(Security_Association * sa) {
+        if(&sa->_lru != _lru.tail()) {
+            _lru.remove(&sa->_lru);
+            _lru.insert_tail(&sa->_lru);
+        }
+    }
+
+private:
+    Security_Association _associations[SIZE];
+    _UTIL::Hash<Security_Association, SIZE, Key> _hash;
+    _UTIL::List<Security_Association, Security_Association::LRU_Element> _lru; // unused associations first
+    unsigned int _size;
+    unsigned long _hits;
+    unsigned long _misses;
+    unsigned long _evictions;
+};
+
+__END_SYS
+
+#endif
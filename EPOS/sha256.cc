@@ -0,0 +1,349 @@
+// EPOS SHA-256 Hash Function (FIPS 180-4) Component Implementation
+
+#include "sha256.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define __sha256_x86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define __sha256_armv8
+#endif
+
+__BEGIN_SYS
+
+// Class attributes
+const unsigned int SHA256::H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+const unsigned int SHA256::K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// Class methods
+bool SHA256::hardware()
+{
+#if defined(__sha256_x86)
+    static const bool instructions = Traits<SHA256>::HARDWARE && __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#elif defined(__sha256_armv8)
+    static const bool instructions = Traits<SHA256>::HARDWARE && (getauxval(AT_HWCAP) & HWCAP_SHA2);
+#else
+    static const bool instructions = false;
+#endif
+    return instructions;
+}
+
+unsigned int SHA256::lanes()
+{
+#ifdef __sha256_x86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if(Traits<SHA256>::SIMD && avx2 && !hardware())
+        return LANES;
+#endif
+    return 1;
+}
+
+const char * SHA256::backend()
+{
+    if(hardware()) {
+#if defined(__sha256_x86)
+        return "SHA-NI";
+#elif defined(__sha256_armv8)
+        return "ARMv8 SHA2";
+#endif
+    }
+    return (lanes() > 1) ? "software (AVX2 multi-buffer)" : "software";
+}
+
+void SHA256::compress(State & state, const unsigned char * blocks, size_t n)
+{
+    if(hardware())
+        hardware_compress(state, blocks, n);
+    else
+        scalar_compress(state, blocks, n);
+}
+
+void SHA256::digest(unsigned char (* digests)[DIGEST_SIZE], const unsigned char * const * messages, const size_t * lengths, size_t n)
+{
+    db<SHA256>(TRC) << "SHA256::digest(n=" << n << ")" << std::endl;
+
+#ifdef __sha256_x86
+    if(lanes() == LANES) {
+        for(size_t base = 0; base < n; base += LANES) {
+            unsigned int lanes = (n - base < LANES) ? n - base : LANES;
+            if(lanes == 1) {
+                digest(digests[base], messages[base], lengths[base]);
+                continue;
+            }
+
+            // Each message is its whole blocks followed by one or two padded blocks (tail)
+            // Lanes past the last message hash a copy of the first one, and their digests are dropped
+            const unsigned char * message[LANES];
+            unsigned char tail[LANES][2 * BLOCK_SIZE];
+            size_t whole[LANES], total[LANES];
+            size_t common = ~size_t(0); // blocks all lanes have
+            for(unsigned int i = 0; i < LANES; i++) {
+                size_t m = base + ((i < lanes) ? i : 0);
+                message[i] = messages[m];
+                whole[i] = lengths[m] / BLOCK_SIZE;
+                total[i] = whole[i] + pad(tail[i], &message[i][whole[i] * BLOCK_SIZE], lengths[m] % BLOCK_SIZE, lengths[m]);
+                if(total[i] < common)
+                    common = total[i];
+            }
+
+            unsigned int state[8][LANES];
+            for(unsigned int j = 0; j < 8; j++)
+                for(unsigned int i = 0; i < LANES; i++)
+                    state[j][i] = H0[j];
+
+            for(size_t k = 0; k < common; k++) {
+                const unsigned char * blocks[LANES];
+                for(unsigned int i = 0; i < LANES; i++)
+                    blocks[i] = (k < whole[i]) ? &message[i][k * BLOCK_SIZE] : &tail[i][(k - whole[i]) * BLOCK_SIZE];
+                avx2_compress(state, blocks);
+            }
+
+            // The blocks only some messages have go through compress()
+            for(unsigned int i = 0; i < lanes; i++) {
+                State s;
+                for(unsigned int j = 0; j < 8; j++)
+                    s[j] = state[j][i];
+                size_t k = common;
+                if(k < whole[i]) {
+                    compress(s, &message[i][k * BLOCK_SIZE], whole[i] - k);
+                    k = whole[i];
+                }
+                if(k < total[i])
+                    compress(s, &tail[i][(k - whole[i]) * BLOCK_SIZE], total[i] - k);
+                store(digests[base + i], s);
+            }
+        }
+        return;
+    }
+#endif
+
+    for(size_t i = 0; i < n; i++)
+        digest(digests[i], messages[i], lengths[i]);
+}
+
+static inline unsigned int rotr(unsigned int x, unsigned int n) { return (x >> n) | (x << (32 - n)); }
+
+void SHA256::scalar_compress(State & state, const unsigned char * blocks, size_t n)
+{
+    for(; n > 0; n--, blocks += BLOCK_SIZE) {
+        unsigned int w[16];
+        for(unsigned int t = 0; t < 16; t++)
+            w[t] = (blocks[4 * t] << 24) | (blocks[4 * t + 1] << 16) | (blocks[4 * t + 2] << 8) | blocks[4 * t + 3];
+
+        unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+        unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+        for(unsigned int t = 0; t < 64; t++) {
+            if(t >= 16) {
+                unsigned int w2 = w[(t - 2) & 15], w15 = w[(t - 15) & 15];
+                w[t & 15] += (rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10)) + w[(t - 7) & 15] + (rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3));
+            }
+            unsigned int t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[t] + w[t & 15];
+            unsigned int t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) | (c & (a | b)));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if defined(__sha256_x86)
+
+// SHA256RNDS2 runs two rounds on the state split as ABEF and CDGH; SHA256MSG1 and SHA256MSG2 compute four
+// words of the message schedule from the previous sixteen
+__attribute__((target("sha,sse4.1")))
+static inline __m128i sha_ni_schedule(__m128i w0, __m128i w4, __m128i w8, __m128i w12)
+{
+    return _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(w0, w4), _mm_alignr_epi8(w12, w8, 4)), w12);
+}
+
+__attribute__((target("sha,sse4.1")))
+static inline void sha_ni_rounds(__m128i & abef, __m128i & cdgh, __m128i w, const unsigned int * k)
+{
+    __m128i wk = _mm_add_epi32(w, _mm_loadu_si128(reinterpret_cast<const __m128i *>(k)));
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+    abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0e));
+}
+
+__attribute__((target("sha,sse4.1")))
+void SHA256::hardware_compress(State & state, const unsigned char * blocks, size_t n)
+{
+    const __m128i swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL); // big-endian words
+
+    __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0]));
+    __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4]));
+    __m128i cdab = _mm_shuffle_epi32(dcba, 0xb1);
+    __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+    for(; n > 0; n--, blocks += BLOCK_SIZE) {
+        const __m128i * in = reinterpret_cast<const __m128i *>(blocks);
+        __m128i abef0 = abef, cdgh0 = cdgh;
+
+        __m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128(&in[0]), swap);
+        __m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128(&in[1]), swap);
+        __m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128(&in[2]), swap);
+        __m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128(&in[3]), swap);
+        sha_ni_rounds(abef, cdgh, w0, &K[0]);
+        sha_ni_rounds(abef, cdgh, w1, &K[4]);
+        sha_ni_rounds(abef, cdgh, w2, &K[8]);
+        sha_ni_rounds(abef, cdgh, w3, &K[12]);
+        for(unsigned int t = 16; t < 64; t += 16) {
+            w0 = sha_ni_schedule(w0, w1, w2, w3);
+            sha_ni_rounds(abef, cdgh, w0, &K[t]);
+            w1 = sha_ni_schedule(w1, w2, w3, w0);
+            sha_ni_rounds(abef, cdgh, w1, &K[t + 4]);
+            w2 = sha_ni_schedule(w2, w3, w0, w1);
+            sha_ni_rounds(abef, cdgh, w2, &K[t + 8]);
+            w3 = sha_ni_schedule(w3, w0, w1, w2);
+            sha_ni_rounds(abef, cdgh, w3, &K[t + 12]);
+        }
+
+        abef = _mm_add_epi32(abef, abef0);
+        cdgh = _mm_add_epi32(cdgh, cdgh0);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]), _mm_blend_epi16(feba, dchg, 0xf0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_rotr(__m256i x, int n)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// The message words of the eight blocks are transposed so that each register holds the same word of all lanes
+__attribute__((target("avx2")))
+void SHA256::avx2_compress(unsigned int state[8][LANES], const unsigned char * blocks[LANES])
+{
+    const __m256i swap = _mm256_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL, 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m256i w[16];
+    for(unsigned int half = 0; half < 2; half++) {
+        __m256i r[LANES];
+        for(unsigned int i = 0; i < LANES; i++)
+            r[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&blocks[i][32 * half]));
+
+        __m256i t[LANES], u[LANES];
+        for(unsigned int i = 0; i < LANES; i += 2) {
+            t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+            t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+        }
+        for(unsigned int i = 0; i < LANES; i += 4) {
+            u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+            u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+            u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+            u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+        }
+        for(unsigned int j = 0; j < 4; j++) {
+            w[8 * half + j] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u[j], u[j + 4], 0x20), swap);
+            w[8 * half + j + 4] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u[j], u[j + 4], 0x31), swap);
+        }
+    }
+
+    __m256i s[8];
+    for(unsigned int j = 0; j < 8; j++)
+        s[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(state[j]));
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for(unsigned int t = 0; t < 64; t++) {
+        if(t >= 16) {
+            __m256i w2 = w[(t - 2) & 15], w15 = w[(t - 15) & 15];
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(avx2_rotr(w2, 17), avx2_rotr(w2, 19)), _mm256_srli_epi32(w2, 10));
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(avx2_rotr(w15, 7), avx2_rotr(w15, 18)), _mm256_srli_epi32(w15, 3));
+            w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+        }
+        __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(avx2_rotr(e, 6), avx2_rotr(e, 11)), avx2_rotr(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, S1), _mm256_add_epi32(ch, _mm256_add_epi32(_mm256_set1_epi32(K[t]), w[t & 15])));
+        __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(avx2_rotr(a, 2), avx2_rotr(a, 13)), avx2_rotr(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, _mm256_add_epi32(S0, maj));
+    }
+
+    __m256i v[8] = {a, b, c, d, e, f, g, h};
+    for(unsigned int j = 0; j < 8; j++)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(state[j]), _mm256_add_epi32(s[j], v[j]));
+}
+
+#elif defined(__sha256_armv8)
+
+// SHA256H and SHA256H2 run four rounds on the state split as ABCD and EFGH; SHA256SU0 and SHA256SU1 compute four
+// words of the message schedule from the previous sixteen
+__attribute__((target("+sha2")))
+void SHA256::hardware_compress(State & state, const unsigned char * blocks, size_t n)
+{
+    uint32x4_t abcd = vld1q_u32(&state[0]);
+    uint32x4_t efgh = vld1q_u32(&state[4]);
+
+    for(; n > 0; n--, blocks += BLOCK_SIZE) {
+        uint32x4_t abcd0 = abcd, efgh0 = efgh;
+
+        uint32x4_t w[4];
+        for(unsigned int i = 0; i < 4; i++)
+            w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&blocks[16 * i])));
+
+        for(unsigned int i = 0; i < 16; i++) {
+            if(i >= 4)
+                w[i % 4] = vsha256su1q_u32(vsha256su0q_u32(w[i % 4], w[(i + 1) % 4]), w[(i + 2) % 4], w[(i + 3) % 4]);
+            uint32x4_t wk = vaddq_u32(w[i % 4], vld1q_u32(&K[4 * i]));
+            uint32x4_t previous = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, wk);
+            efgh = vsha256h2q_u32(efgh, previous, wk);
+        }
+
+        abcd = vaddq_u32(abcd, abcd0);
+        efgh = vaddq_u32(efgh, efgh0);
+    }
+
+    vst1q_u32(&state[0], abcd);
+    vst1q_u32(&state[4], efgh);
+}
+
+#else
+
+// Never called, since hardware() is false
+void SHA256::hardware_compress(State &, const unsigned char *, size_t) {}
+
+#endif
+
+__END_SYS
@@ -0,0 +1,132 @@
+// EPOS SHA-256 Hash Function (FIPS 180-4) Component Declarations
+
+#ifndef __sha256_h
+#define __sha256_h
+
+#include "epos_common.h"
+#include <cstring>
+
+__BEGIN_SYS
+
+class SHA256
+{
+public:
+    static const unsigned int DIGEST_SIZE = 32;
+    static const unsigned int BLOCK_SIZE = 64;
+
+private:
+    static const unsigned int LANES = 8; // messages hashed side by side by multi-buffer digest()
+
+    typedef unsigned int State[8];
+
+public:
+    SHA256() { init(); }
+
+    // Incremental interface: init(), then update() with each piece of the message, then finish(digest)
+    void init() {
+        std::memcpy(_state, H0, sizeof(_state));
+        _length = 0;
+        _buffered = 0;
+    }
+
+    void update(const void * data, size_t length) {
+        const unsigned char * message = reinterpret_cast<const unsigned char *>(data);
+        _length += length;
+
+        if(_buffered) {
+            size_t n = (length < BLOCK_SIZE - _buffered) ? length : BLOCK_SIZE - _buffered;
+            std::memcpy(&_buffer[_buffered], message, n);
+            _buffered += n;
+            message += n;
+            length -= n;
+            if(_buffered < BLOCK_SIZE)
+                return;
+            compress(_state, _buffer, 1);
+            _buffered = 0;
+        }
+
+        size_t blocks = length / BLOCK_SIZE;
+        if(blocks) {
+            compress(_state, message, blocks);
+            message += blocks * BLOCK_SIZE;
+            length -= blocks * BLOCK_SIZE;
+        }
+
+        if(length) {
+            std::memcpy(_buffer, message, length);
+            _buffered = length;
+        }
+    }
+
+    void finish(unsigned char digest[DIGEST_SIZE]) {
+        unsigned char tail[2 * BLOCK_SIZE];
+        compress(_state, tail, pad(tail, _buffer, _buffered, _length));
+        store(digest, _state);
+    }
+
+    // One-shot digest of a whole message: its blocks are compressed where they are, only the padded tail is copied
+    static void digest(unsigned char out[DIGEST_SIZE], const void * data, size_t length) {
+        const unsigned char * message = reinterpret_cast<const unsigned char *>(data);
+        size_t whole = length / BLOCK_SIZE;
+        State state;
+        std::memcpy(state, H0, sizeof(state));
+        if(whole)
+            compress(state, message, whole);
+        unsigned char tail[2 * BLOCK_SIZE];
+        compress(state, tail, pad(tail, &message[whole * BLOCK_SIZE], length % BLOCK_SIZE, length));
+        store(out, state);
+    }
+
+    // digests[i] = SHA-256 of messages[i] (lengths[i] bytes), hashing up to lanes() messages at a time
+    static void digest(unsigned char (* digests)[DIGEST_SIZE], const unsigned char * const * messages, const size_t * lengths, size_t n);
+
+    // Number of messages multi-buffer digest() hashes side by side on this CPU
+    static unsigned int lanes();
+
+    static const char * backend();
+
+private:
+    // Runs the compression function on n consecutive blocks, with the CPU instructions if HARDWARE and available
+    static void compress(State & state, const unsigned char * blocks, size_t n);
+    static void scalar_compress(State & state, const unsigned char * blocks, size_t n);
+    static void hardware_compress(State & state, const unsigned char * blocks, size_t n);
+    static bool hardware();
+
+    // One block of each of the LANES messages, on states kept word by word (state[j][i] is word j of lane i)
+    static void avx2_compress(unsigned int state[8][LANES], const unsigned char * blocks[LANES]);
+
+    // Pads the last length % BLOCK_SIZE bytes (rest) of a length-byte message into tail and returns its blocks (1 or 2)
+    static unsigned int pad(unsigned char tail[2 * BLOCK_SIZE], const unsigned char * rest, unsigned int rest_size, unsigned long long length) {
+        if(rest_size)
+            std::memcpy(tail, rest, rest_size);
+        tail[rest_size] = 0x80;
+        unsigned int blocks = (rest_size + 1 + 8 > BLOCK_SIZE) ? 2 : 1;
+        std::memset(&tail[rest_size + 1], 0, blocks * BLOCK_SIZE - 8 - (rest_size + 1));
+        unsigned long long bits = length * 8;
+        for(unsigned int i = 0; i < 8; i++)
+            tail[blocks * BLOCK_SIZE - 1 - i] = bits >> (8 * i);
+        return blocks;
+    }
+
+    static void store(unsigned char digest[DIGEST_SIZE], const State & state) {
+        for(unsigned int i = 0; i < 8; i++) {
+            digest[4 * i + 0] = state[i] >> 24;
+            digest[4 * i + 1] = state[i] >> 16;
+            digest[4 * i + 2] = state[i] >> 8;
+            digest[4 * i + 3] = state[i];
+        }
+    }
+
+private:
+    State _state;
+    unsigned long long _length; // bytes hashed so far
+    unsigned char _buffer[BLOCK_SIZE]; // bytes of an incomplete block
+    unsigned int _buffered;
+
+    static const unsigned int H0[8];
+    static const unsigned int K[64];
+};
+
+__END_SYS
+
+#endif
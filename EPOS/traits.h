@@ -18,4 +18,92 @@ template<> struct Traits<Build> : public Traits<void>
     static const unsigned int NODES = 10001;
 };
 
+namespace EPOS { namespace S {
+class Cipher;
+class Diffie_Hellman;
+class Poly1305;
+class SHA256;
+class Security_Association_Table;
+} }
+
+template<> struct Traits<EPOS::S::Cipher> : public Traits<void>
+{
+    // Round implementation of Software_AES used by Cipher
+    // BYTE runs the byte-oriented sub_bytes, shift_rows and mix_columns steps over the state
+    // T_TABLE runs each round as 16 lookups of four 1 KB tables combining those steps, on 32-bit columns
+    // (4 KB more of tables for decryption; table lookups depend on the data in both, as in any table-based AES)
+    enum { BYTE, T_TABLE };
+    static const unsigned int ENGINE = T_TABLE;
+
+    // Use the AES instructions of the CPU (AES-NI on x86, Crypto Extensions on aarch64) when the CPU has them
+    // (checked at run time), falling back to ENGINE otherwise
+    static const bool HARDWARE = true;
+};
+
+template<> struct Traits<EPOS::S::Diffie_Hellman> : public Traits<void>
+{
+    // Field arithmetic used by the elliptic curve point formulas
+    enum { BARRETT, MONTGOMERY };
+    static const unsigned int FIELD = BARRETT;
+
+    // Scalar multiplication algorithm used by Elliptic_Curve_Point::operator*=
+    // BINARY doubles and adds bit by bit, branching on the key bits
+    // WINDOW runs WINDOW_BITS doublings and one addition of a precomputed odd multiple per window, whatever
+    // the key, selecting the multiple from the table without branching on the key (constant-time table selection)
+    // LADDER runs a co-Z Montgomery ladder: one conjugate and one plain co-Z addition per key bit,
+    // with conditional swaps instead of branches (the sequence of operations only depends on the bit length of the key)
+    // Neither makes the whole multiplication constant time: the field operations underneath still branch on
+    // their operands (conditional modulus subtraction in += and -=, reduction loops, early return of *= by 1)
+    enum { BINARY, WINDOW, LADDER };
+    static const unsigned int MULTIPLICATION = WINDOW;
+    static const unsigned int WINDOW_BITS = 4;
+
+    // Key generation with the default base point adds precomputed multiples of it from a table
+    // built on first use (2^(GENERATOR_WINDOW_BITS - 1) points per window), instead of doubling
+    static const bool GENERATOR_TABLE = true;
+    static const unsigned int GENERATOR_WINDOW_BITS = 4;
+
+    // Number of keys Diffie_Hellman::shared_keys() converts to affine coordinates with a single inversion
+    static const unsigned int BATCH_SIZE = 32;
+};
+
+template<> struct Traits<EPOS::S::Poly1305> : public Traits<void>
+{
+    // Accumulator arithmetic modulo 2^130 - 5
+    // BIGNUM runs the generic Bignum<17> modular addition and multiplication for each block
+    // RADIX_26 keeps the accumulator in five 26-bit limbs and only partially propagates carries between blocks
+    enum { BIGNUM, RADIX_26 };
+    static const unsigned int ENGINE = RADIX_26;
+
+    // RADIX_26 only: precompute r^2, r^3 and r^4 when the key is installed and evaluate four blocks at a time,
+    // as (h + c_1) * r^4 + c_2 * r^3 + c_3 * r^2 + c_4 * r, whose four products do not depend on each other
+    static const bool R_POWERS = true;
+
+    // RADIX_26 only: batch verification (Poly1305::verify() for n messages) runs four messages side by side
+    // in the 64-bit lanes of AVX2 registers, if the CPU supports it (checked at run time)
+    static const bool SIMD = true;
+
+    // Number of (nonce, AES(k, nonce)) pairs each Poly1305 object keeps to skip the AES encryption of repeated nonces
+    // (0 disables the cache; TSTP nonces rarely repeat, so it only pays off for applications that reuse them)
+    static const unsigned int PAD_CACHE = 0;
+};
+
+template<> struct Traits<EPOS::S::SHA256> : public Traits<void>
+{
+    // Use the SHA-256 instructions of the CPU (SHA-NI on x86, SHA2 Crypto Extensions on aarch64) when the CPU
+    // has them (checked at run time), falling back to the portable rounds otherwise
+    static const bool HARDWARE = true;
+
+    // Multi-buffer hashing (SHA256::digest() of n messages) runs eight messages side by side in the 32-bit lanes
+    // of AVX2 registers, if the CPU supports it (checked at run time) and HARDWARE does not already apply
+    static const bool SIMD = true;
+};
+
+template<> struct Traits<EPOS::S::Security_Association_Table> : public Traits<void>
+{
+    // Number of peers whose session keys a Security_Association_Table keeps (and of its hash buckets);
+    // establishing a session with one more peer evicts the least recently used association
+    static const unsigned int SIZE = 32;
+};
+
 #endif
@@ -1,15 +1,38 @@
 #include <iostream>
 #include <chrono>
 #include <fstream>
+#include <string>
+#include <algorithm>
 #include <cryptopp/sha.h>
 #include "EPOS/diffie_hellman.h"
 #include "EPOS/poly1305.h"
 #include "EPOS/cipher.h"
+#include "EPOS/random.h"
+#include "EPOS/sha256.h"
+#include "EPOS/key_derivation.h"
+#include "EPOS/security_association.h"
 #include "EPOS/benchmark_stats.h"
 
 #define ITERATIONS 10000
 #define MAX_POLY1305_MESSAGE_SIZE 264 // Size of OTP for Forwarding Grant
 #define MAX_AES_MESSAGE_SIZE 192 // Size of payload for Forwarding Grant
+#define FRAME_HEADER_SIZE 9 // IEEE 802.15.4 header (frame control, sequence number, PAN id and short addresses)
+#define FRAME_PAYLOAD_SIZE 96 // Whole AES blocks left in a 127-byte frame after the header, a 16-byte MIC and the CRC
+#define FRAME_MIC_SIZE 16
+#ifdef EPOS_PRODUCTION
+#define CONFIGURATION "production"
+#define LATENCIES_CSV "latencies.csv"
+#define OTHER_CONFIGURATION "debug"
+#define OTHER_LATENCIES_CSV "latencies_debug.csv"
+#else
+#define CONFIGURATION "debug"
+#define LATENCIES_CSV "latencies_debug.csv"
+#define OTHER_CONFIGURATION "production"
+#define OTHER_LATENCIES_CSV "latencies.csv"
+#endif
+#define POLY1305_BATCH 32 // Messages per Poly1305 batch verification
+#define SHA256_BATCH 32 // Messages per multi-buffer SHA-256 call
+#define FIELD_OPERATIONS 64 // Field operations timed together, as a single one is close to the clock resolution
 
 struct DH_Data {
     EPOS::S::Diffie_Hellman::Public_Key public_key;
@@ -35,19 +58,14 @@ DH_Data dh_test_data[ITERATIONS];
 Poly1305_Data poly1305_test_data[ITERATIONS];
 AES_Data aes_test_data[ITERATIONS];
 SHA256_Data sha256_test_data[ITERATIONS];
+EPOS::S::Bignum<EPOS::S::Diffie_Hellman::SECRET_SIZE> bignum_sink;
 
 void fill_random(void* buffer, size_t size) {
-    unsigned char* buf = static_cast<unsigned char*>(buffer);
-    for (size_t i = 0; i < size; ++i) {
-        buf[i] = static_cast<unsigned char>(rand() % 256);
-    }
+    EPOS::S::Random::fill(buffer, size);
 }
 
 
 int main() {
-    // Seed random number generator
-    srand(static_cast<unsigned int>(time(nullptr)));
-
     // Populate DH_Data
     for (int i = 0; i < ITERATIONS; ++i) {
         fill_random(&dh_test_data[i].public_key, sizeof(dh_test_data[i].public_key));
@@ -74,9 +92,25 @@ int main() {
 
     std::cout << "Structures populated with random data." << std::endl;
     std::cout << "Starting benchmarks..." << std::endl;
+    std::cout << "Build configuration: " << CONFIGURATION << std::endl;
+    std::cout << "ECDH field arithmetic: "
+              << ((Traits<EPOS::S::Diffie_Hellman>::FIELD == Traits<EPOS::S::Diffie_Hellman>::MONTGOMERY) ? "Montgomery" : "Barrett")
+              << std::endl;
+    std::cout << "ECDH scalar multiplication: ";
+    if (Traits<EPOS::S::Diffie_Hellman>::MULTIPLICATION == Traits<EPOS::S::Diffie_Hellman>::WINDOW)
+        std::cout << "fixed window (w=" << Traits<EPOS::S::Diffie_Hellman>::WINDOW_BITS << ")" << std::endl;
+    else if (Traits<EPOS::S::Diffie_Hellman>::MULTIPLICATION == Traits<EPOS::S::Diffie_Hellman>::LADDER)
+        std::cout << "co-Z Montgomery ladder" << std::endl;
+    else
+        std::cout << "binary double-and-add" << std::endl;
+    std::cout << "AES backend (Cipher): " << EPOS::S::Cipher::backend() << std::endl;
+    std::cout << "SHA-256 backend (EPOS): " << EPOS::S::SHA256::backend() << std::endl;
+    std::cout << "ECDH key generation: "
+              << (Traits<EPOS::S::Diffie_Hellman>::GENERATOR_TABLE ? "base point table" : "generic scalar multiplication")
+              << std::endl;
 
     // Open CSV file for results
-    std::ofstream csv_file("latencies.csv");
+    std::ofstream csv_file(LATENCIES_CSV);
     csv_file << "primitive,iteration,ns\n";
 
     // Declare timing variables once
@@ -84,6 +118,8 @@ int main() {
     CryptoPP::SHA256 hash;
     unsigned char mac[16];
     EPOS::S::Cipher cipher;
+    EPOS::S::Software_AES<16, Traits<EPOS::S::Cipher>::BYTE> aes_byte;
+    EPOS::S::Software_AES<16, Traits<EPOS::S::Cipher>::T_TABLE> aes_t_table;
     unsigned char ciphertext[EPOS::S::Diffie_Hellman::SECRET_SIZE];
 
     // SHA-256 benchmark
@@ -102,6 +138,52 @@ int main() {
         csv_file << "sha256," << i << "," << duration.count() << "\n";
     }
 
+    // In-tree SHA-256 on the same data, one message per call and SHA256_BATCH messages per multi-buffer call
+    // (ns per message), checked against CryptoPP
+    std::cout << "Running EPOS SHA-256 benchmark (" << EPOS::S::SHA256::lanes() << " lanes)..." << std::endl;
+    {
+        unsigned char digest[EPOS::S::SHA256::DIGEST_SIZE];
+        unsigned int mismatches = 0;
+        // Warmup
+        for (int i = 0; i < 100; ++i) {
+            EPOS::S::SHA256::digest(digest, sha256_test_data[i % ITERATIONS].data, sizeof(sha256_test_data[i % ITERATIONS].data));
+        }
+        // Measured iterations
+        for (int i = 0; i < ITERATIONS; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            EPOS::S::SHA256::digest(digest, sha256_test_data[i].data, sizeof(sha256_test_data[i].data));
+            auto end = std::chrono::steady_clock::now();
+
+            hash.CalculateDigest(sha256_digest, sha256_test_data[i].data, sizeof(sha256_test_data[i].data));
+            if (std::memcmp(digest, sha256_digest, sizeof(digest)) != 0)
+                mismatches++;
+
+            auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+            csv_file << "sha256_epos," << i << "," << duration.count() << "\n";
+        }
+        if (mismatches)
+            std::cerr << "EPOS SHA-256 differs from CryptoPP on " << mismatches << " messages" << std::endl;
+
+        static unsigned char batch_digests[ITERATIONS][EPOS::S::SHA256::DIGEST_SIZE];
+        static const unsigned char * batch_messages[ITERATIONS];
+        static size_t batch_lengths[ITERATIONS];
+        for (int i = 0; i < ITERATIONS; ++i) {
+            batch_messages[i] = sha256_test_data[i].data;
+            batch_lengths[i] = sizeof(sha256_test_data[i].data);
+        }
+        // Warmup
+        EPOS::S::SHA256::digest(batch_digests, batch_messages, batch_lengths, SHA256_BATCH);
+        // Measured iterations
+        for (int i = 0; i + SHA256_BATCH <= ITERATIONS; i += SHA256_BATCH) {
+            auto start = std::chrono::steady_clock::now();
+            EPOS::S::SHA256::digest(&batch_digests[i], &batch_messages[i], &batch_lengths[i], SHA256_BATCH);
+            auto end = std::chrono::steady_clock::now();
+
+            auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+            csv_file << "sha256_batch," << i / SHA256_BATCH << "," << duration.count() / SHA256_BATCH << "\n";
+        }
+    }
+
     // AES encryption benchmark
     std::cout << "Running AES encryption benchmark..." << std::endl;
     // Warmup
@@ -121,6 +203,21 @@ int main() {
         auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
         csv_file << "aes128_enc," << i << "," << duration.count() << "\n";
     }
+    // Both software round implementations side by side (aes128_enc is whichever backend Cipher uses)
+    for (int i = 0; i < ITERATIONS; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        aes_byte.encrypt(reinterpret_cast<const unsigned char*>(aes_test_data[i].message), 
+                         reinterpret_cast<const unsigned char*>(aes_test_data[i].key), 
+                         ciphertext);
+        auto middle = std::chrono::steady_clock::now();
+        aes_t_table.encrypt(reinterpret_cast<const unsigned char*>(aes_test_data[i].message), 
+                            reinterpret_cast<const unsigned char*>(aes_test_data[i].key), 
+                            ciphertext);
+        auto end = std::chrono::steady_clock::now();
+
+        csv_file << "aes128_enc_byte," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(middle - start).count() << "\n";
+        csv_file << "aes128_enc_t_table," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count() << "\n";
+    }
 
     // AES decryption benchmark
     std::cout << "Running AES decryption benchmark..." << std::endl;
@@ -137,6 +234,47 @@ int main() {
         auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
         csv_file << "aes128_dec," << i << "," << duration.count() << "\n";
     }
+    for (int i = 0; i < ITERATIONS; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        aes_byte.decrypt(ciphertext, reinterpret_cast<const unsigned char*>(aes_test_data[i].key), reinterpret_cast<unsigned char*>(aes_test_data[i].message));
+        auto middle = std::chrono::steady_clock::now();
+        aes_t_table.decrypt(ciphertext, reinterpret_cast<const unsigned char*>(aes_test_data[i].key), reinterpret_cast<unsigned char*>(aes_test_data[i].message));
+        auto end = std::chrono::steady_clock::now();
+
+        csv_file << "aes128_dec_byte," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(middle - start).count() << "\n";
+        csv_file << "aes128_dec_t_table," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count() << "\n";
+    }
+
+    // AES bulk modes over the whole MAX_AES_MESSAGE_SIZE payload, with one key expansion per message as in aes128_enc
+    std::cout << "Running AES bulk mode benchmark..." << std::endl;
+    EPOS::S::Cipher aes_ecb(EPOS::S::Cipher::ECB);
+    EPOS::S::Cipher aes_cbc(EPOS::S::Cipher::CBC);
+    EPOS::S::Cipher aes_ctr(EPOS::S::Cipher::CTR);
+    unsigned char aes_iv[EPOS::S::Cipher::KEY_SIZE] = {};
+    unsigned char aes_payload[MAX_AES_MESSAGE_SIZE];
+    // Warmup
+    for (int i = 0; i < 100; ++i) {
+        aes_ctr.encrypt(aes_test_data[i % ITERATIONS].message, MAX_AES_MESSAGE_SIZE,
+                        reinterpret_cast<const unsigned char*>(aes_test_data[i % ITERATIONS].key), aes_payload, aes_iv);
+    }
+    // Measured iterations (CBC decryption runs in place on the CBC ciphertext)
+    for (int i = 0; i < ITERATIONS; ++i) {
+        const unsigned char * key = reinterpret_cast<const unsigned char*>(aes_test_data[i].key);
+        auto start = std::chrono::steady_clock::now();
+        aes_ecb.encrypt(aes_test_data[i].message, MAX_AES_MESSAGE_SIZE, key, aes_payload);
+        auto ecb = std::chrono::steady_clock::now();
+        aes_cbc.encrypt(aes_test_data[i].message, MAX_AES_MESSAGE_SIZE, key, aes_payload, aes_iv);
+        auto cbc_enc = std::chrono::steady_clock::now();
+        aes_cbc.decrypt(aes_payload, MAX_AES_MESSAGE_SIZE, key, aes_payload, aes_iv);
+        auto cbc_dec = std::chrono::steady_clock::now();
+        aes_ctr.encrypt(aes_test_data[i].message, MAX_AES_MESSAGE_SIZE, key, aes_payload, aes_iv);
+        auto end = std::chrono::steady_clock::now();
+
+        csv_file << "aes128_ecb," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(ecb - start).count() << "\n";
+        csv_file << "aes128_cbc_enc," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(cbc_enc - ecb).count() << "\n";
+        csv_file << "aes128_cbc_dec," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(cbc_dec - cbc_enc).count() << "\n";
+        csv_file << "aes128_ctr," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(end - cbc_dec).count() << "\n";
+    }
 
     // Poly1305 MAC benchmark
     std::cout << "Running Poly1305 MAC benchmark..." << std::endl;
@@ -147,17 +285,120 @@ int main() {
                              reinterpret_cast<const unsigned char*>(poly1305_test_data[i % ITERATIONS].message), 
                              sizeof(poly1305_test_data[i % ITERATIONS].message));
     }
-    // Measured iterations
+    // Measured iterations: construction (key setup), stamping, and both together
     for (int i = 0; i < ITERATIONS; ++i) {
         auto start = std::chrono::steady_clock::now();
         EPOS::S::Poly1305 poly1305(poly1305_test_data[i].key, poly1305_test_data[i].nonce);
+        auto constructed = std::chrono::steady_clock::now();
         poly1305.stamp(mac, poly1305_test_data[i].nonce, 
                       reinterpret_cast<const unsigned char*>(poly1305_test_data[i].message), 
                       sizeof(poly1305_test_data[i].message));
         auto end = std::chrono::steady_clock::now();
         
         auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        auto construction = std::chrono::duration_cast<std::chrono::nanoseconds>(constructed - start);
+        auto stamping = std::chrono::duration_cast<std::chrono::nanoseconds>(end - constructed);
         csv_file << "poly1305," << i << "," << duration.count() << "\n";
+        csv_file << "poly1305_construct," << i << "," << construction.count() << "\n";
+        csv_file << "poly1305_stamp," << i << "," << stamping.count() << "\n";
+    }
+
+    // Secured IEEE 802.15.4 frame: AES encryption of the payload and a Poly1305 MAC of header and ciphertext
+    // (two passes, two key schedules) against single-pass CCM* under one encryption-only key schedule
+    std::cout << "Running secured frame benchmark..." << std::endl;
+    unsigned char frame[FRAME_HEADER_SIZE + FRAME_PAYLOAD_SIZE + FRAME_MIC_SIZE];
+    unsigned char * frame_payload = &frame[FRAME_HEADER_SIZE];
+    unsigned char * frame_mic = &frame[FRAME_HEADER_SIZE + FRAME_PAYLOAD_SIZE];
+    // Warmup
+    for (int i = 0; i < 100; ++i) {
+        EPOS::S::Cipher::Key_Schedule schedule(reinterpret_cast<const unsigned char*>(aes_test_data[i % ITERATIONS].key), false);
+        EPOS::S::Cipher::ccm_encrypt(schedule, poly1305_test_data[i % ITERATIONS].nonce, frame, FRAME_HEADER_SIZE,
+                                     frame_payload, FRAME_PAYLOAD_SIZE, frame_mic, FRAME_MIC_SIZE);
+    }
+    // Measured iterations
+    for (int i = 0; i < ITERATIONS; ++i) {
+        const unsigned char * key = reinterpret_cast<const unsigned char*>(aes_test_data[i].key);
+        const unsigned char * nonce = poly1305_test_data[i].nonce; // its first CCM_NONCE_SIZE bytes for CCM*
+        std::memcpy(frame, aes_test_data[i].message, FRAME_HEADER_SIZE + FRAME_PAYLOAD_SIZE);
+
+        auto start = std::chrono::steady_clock::now();
+        aes_ecb.encrypt(frame_payload, FRAME_PAYLOAD_SIZE, key, frame_payload);
+        EPOS::S::Poly1305 poly1305(poly1305_test_data[i].key, nonce);
+        poly1305.stamp(frame_mic, nonce, frame, FRAME_HEADER_SIZE + FRAME_PAYLOAD_SIZE);
+        auto separate = std::chrono::steady_clock::now();
+
+        std::memcpy(frame, aes_test_data[i].message, FRAME_HEADER_SIZE + FRAME_PAYLOAD_SIZE);
+        auto ccm_start = std::chrono::steady_clock::now();
+        EPOS::S::Cipher::Key_Schedule schedule(key, false);
+        EPOS::S::Cipher::ccm_encrypt(schedule, nonce, frame, FRAME_HEADER_SIZE, frame_payload, FRAME_PAYLOAD_SIZE, frame_mic, FRAME_MIC_SIZE);
+        auto ccm_encrypted = std::chrono::steady_clock::now();
+        EPOS::S::Cipher::Key_Schedule receiver(key, false);
+        bool valid = EPOS::S::Cipher::ccm_decrypt(receiver, nonce, frame, FRAME_HEADER_SIZE, frame_payload, FRAME_PAYLOAD_SIZE, frame_mic, FRAME_MIC_SIZE);
+        auto end = std::chrono::steady_clock::now();
+        if (!valid)
+            std::cerr << "CCM* decryption failed at iteration " << i << std::endl;
+
+        csv_file << "frame_aes_poly1305," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(separate - start).count() << "\n";
+        csv_file << "frame_ccm_enc," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(ccm_encrypted - ccm_start).count() << "\n";
+        csv_file << "frame_ccm_dec," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(end - ccm_encrypted).count() << "\n";
+    }
+
+    // Poly1305 batch verification benchmark (ns per message, POLY1305_BATCH messages per call)
+    std::cout << "Running Poly1305 batch verification benchmark (" << EPOS::S::Poly1305::lanes() << " lanes)..." << std::endl;
+    {
+        static EPOS::S::Poly1305 batch_keys[ITERATIONS];
+        static unsigned char batch_macs[ITERATIONS][16];
+        static unsigned char batch_nonces[ITERATIONS][16];
+        static const unsigned char * batch_messages[ITERATIONS];
+        static unsigned int batch_lengths[ITERATIONS];
+        static bool batch_results[POLY1305_BATCH];
+        for (int i = 0; i < ITERATIONS; ++i) {
+            new (&batch_keys[i]) EPOS::S::Poly1305(poly1305_test_data[i].key, poly1305_test_data[i].nonce);
+            batch_messages[i] = reinterpret_cast<const unsigned char*>(poly1305_test_data[i].message);
+            batch_lengths[i] = sizeof(poly1305_test_data[i].message);
+            std::memcpy(batch_nonces[i], poly1305_test_data[i].nonce, 16);
+            batch_keys[i].stamp(batch_macs[i], poly1305_test_data[i].nonce, batch_messages[i], batch_lengths[i]);
+        }
+
+        // Warmup
+        EPOS::S::Poly1305::verify(batch_results, batch_keys, batch_macs, batch_nonces, batch_messages, batch_lengths, POLY1305_BATCH);
+        // Measured iterations
+        for (int i = 0; i + POLY1305_BATCH <= ITERATIONS; i += POLY1305_BATCH) {
+            auto start = std::chrono::steady_clock::now();
+            EPOS::S::Poly1305::verify(batch_results, &batch_keys[i], &batch_macs[i], &batch_nonces[i], &batch_messages[i], &batch_lengths[i], POLY1305_BATCH);
+            auto end = std::chrono::steady_clock::now();
+
+            auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+            csv_file << "poly1305_batch," << i / POLY1305_BATCH << "," << duration.count() / POLY1305_BATCH << "\n";
+        }
+    }
+
+    // Poly1305 verify benchmark: matching tags and tags differing only at byte i (poly1305_verify_diff<i>),
+    // interleaved in each iteration, in a rotating order, so that all of them see the same conditions
+    std::cout << "Running Poly1305 verify benchmark..." << std::endl;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        EPOS::S::Poly1305 poly1305(poly1305_test_data[i].key, poly1305_test_data[i].nonce);
+        const unsigned char * message = reinterpret_cast<const unsigned char*>(poly1305_test_data[i].message);
+        unsigned char tag[16];
+        poly1305.stamp(tag, poly1305_test_data[i].nonce, message, sizeof(poly1305_test_data[i].message));
+
+        for (int j = 0; j < 17; ++j) {
+            int position = (i + j) % 17 - 1; // -1 is the matching tag
+            unsigned char candidate[16];
+            std::memcpy(candidate, tag, 16);
+            if (position >= 0)
+                candidate[position] ^= 1;
+
+            auto start = std::chrono::steady_clock::now();
+            bool valid = poly1305.verify(candidate, poly1305_test_data[i].nonce, message, sizeof(poly1305_test_data[i].message));
+            auto end = std::chrono::steady_clock::now();
+            if (valid != (position < 0))
+                std::cerr << "Poly1305 verify failed at byte " << position << std::endl;
+
+            auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+            csv_file << ((position < 0) ? std::string("poly1305_verify") : "poly1305_verify_diff" + std::to_string(position))
+                     << "," << i << "," << duration.count() << "\n";
+        }
     }
 
     // ECDH shared secret benchmark
@@ -176,12 +417,147 @@ int main() {
         csv_file << "ecdh_shared," << i << "," << duration.count() << "\n";
     }
 
+    // Session key derivation from a shared key, once per peer: the KDF alone (both directions, four keys each)
+    // and the whole bundle, with the AES round keys and Poly1305 keys installed
+    std::cout << "Running session key derivation benchmark..." << std::endl;
+    {
+        EPOS::S::Key_Derivation::Direction_Keys keys[2];
+        EPOS::S::Session_Keys session;
+        const unsigned char * context = reinterpret_cast<const unsigned char*>(aes_test_data[0].message); // e.g. both node ids
+        // Warmup
+        for (int i = 0; i < 100; ++i) {
+            session.derive(dh_test_data[i % ITERATIONS].private_key, EPOS::S::Key_Derivation::INITIATOR, context, 32);
+        }
+        // Measured iterations
+        for (int i = 0; i < ITERATIONS; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            EPOS::S::Key_Derivation::derive(dh_test_data[i].private_key, context, 32, keys);
+            auto derived = std::chrono::steady_clock::now();
+            session.derive(dh_test_data[i].private_key, EPOS::S::Key_Derivation::INITIATOR, context, 32);
+            auto end = std::chrono::steady_clock::now();
+
+            csv_file << "kdf_derive," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(derived - start).count() << "\n";
+            csv_file << "kdf_session," << i << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(end - derived).count() << "\n";
+        }
+    }
+
+    // Security association table: establishing a session with a new peer (lookup miss, ECDH shared key and
+    // session keys derived into the table, evicting the least recently used peer) against a cached lookup
+    std::cout << "Running security association benchmark..." << std::endl;
+    {
+        typedef EPOS::S::Security_Association_Table::Node_ID Node_ID;
+        const unsigned int size = EPOS::S::Security_Association_Table::SIZE;
+        static EPOS::S::Security_Association_Table table;
+        static Node_ID ids[ITERATIONS];
+        const unsigned char * context = reinterpret_cast<const unsigned char*>(aes_test_data[0].message);
+        for (int i = 0; i < ITERATIONS; ++i)
+            ids[i] = Node_ID(sha256_test_data[i].data, sizeof(Node_ID));
+
+        // Measured iterations: a session with each peer, the last size of which stay in the table
+        for (int i = 0; i < ITERATIONS; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            EPOS::S::Session_Keys * keys = table.search(ids[i]);
+            if (!keys) {
+                EPOS::S::Diffie_Hellman::Shared_Key secret = EPOS::S::Diffie_Hellman::shared_key(dh_test_data[i].public_key, dh_test_data[i].private_key);
+                keys = &table.insert(ids[i], secret, EPOS::S::Key_Derivation::INITIATOR, context, 32);
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+            csv_file << "sa_establish," << i << "," << duration.count() << "\n";
+        }
+        // Measured iterations: peers in the table
+        for (int i = 0; i < ITERATIONS; ++i) {
+            const Node_ID & id = ids[ITERATIONS - size + i % size];
+            auto start = std::chrono::steady_clock::now();
+            EPOS::S::Session_Keys * keys = table.search(id);
+            auto end = std::chrono::steady_clock::now();
+            if (!keys)
+                std::cerr << "Security association of a cached peer not found" << std::endl;
+
+            auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+            csv_file << "sa_lookup," << i << "," << duration.count() << "\n";
+        }
+        std::cout << "Security associations: " << table.hits() << " hits, " << table.misses() << " misses, "
+                  << table.evictions() << " evictions" << std::endl;
+    }
+
+    // Field multiplication and squaring micro-benchmarks (ns per operation)
+    std::cout << "Running Bignum multiplication and squaring benchmarks..." << std::endl;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        EPOS::S::Bignum<EPOS::S::Diffie_Hellman::SECRET_SIZE> a = dh_test_data[i].private_key;
+        const EPOS::S::Bignum<EPOS::S::Diffie_Hellman::SECRET_SIZE> & b = dh_test_data[(i + 1) % ITERATIONS].private_key;
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < FIELD_OPERATIONS; ++j)
+            a *= b;
+        auto end = std::chrono::steady_clock::now();
+        bignum_sink = a;
+
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        csv_file << "bignum_mult," << i << "," << duration.count() / FIELD_OPERATIONS << "\n";
+    }
+    for (int i = 0; i < ITERATIONS; ++i) {
+        EPOS::S::Bignum<EPOS::S::Diffie_Hellman::SECRET_SIZE> a = dh_test_data[i].private_key;
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < FIELD_OPERATIONS; ++j)
+            a.square();
+        auto end = std::chrono::steady_clock::now();
+        bignum_sink = a;
+
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        csv_file << "bignum_square," << i << "," << duration.count() / FIELD_OPERATIONS << "\n";
+    }
+
+    // ECDH batch shared secret benchmark (amortized cost per key against batch size)
+    std::cout << "Running ECDH batch shared secret benchmark..." << std::endl;
+    {
+        static EPOS::S::Diffie_Hellman::Public_Key batch_public_keys[ITERATIONS];
+        static EPOS::S::Diffie_Hellman::Private_Key batch_private_keys[ITERATIONS];
+        static EPOS::S::Diffie_Hellman::Shared_Key batch_shared_keys[ITERATIONS];
+        for (int i = 0; i < ITERATIONS; ++i) {
+            batch_public_keys[i] = dh_test_data[i].public_key;
+            batch_private_keys[i] = dh_test_data[i].private_key;
+        }
+
+        const size_t batch_sizes[] = {1, 4, 16, 32, 128};
+        for (size_t n : batch_sizes) {
+            std::string primitive = "ecdh_shared_batch" + std::to_string(n);
+            // Warmup
+            EPOS::S::Diffie_Hellman::shared_keys(batch_public_keys, batch_private_keys, batch_shared_keys, n);
+            // Measured iterations, each reporting ns per key
+            for (size_t i = 0; i + n <= ITERATIONS; i += n) {
+                auto start = std::chrono::steady_clock::now();
+                EPOS::S::Diffie_Hellman::shared_keys(&batch_public_keys[i], &batch_private_keys[i], &batch_shared_keys[i], n);
+                auto end = std::chrono::steady_clock::now();
+
+                auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+                csv_file << primitive << "," << i / n << "," << duration.count() / n << "\n";
+            }
+        }
+    }
+
+    // ECDH key pair generation benchmark (random private key times the default base point)
+    std::cout << "Running ECDH key generation benchmark..." << std::endl;
+    // Warmup (also builds the base point table on first use)
+    for (int i = 0; i < 100; ++i) {
+        EPOS::S::Diffie_Hellman dh;
+    }
+    // Measured iterations
+    for (int i = 0; i < ITERATIONS; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        EPOS::S::Diffie_Hellman dh;
+        auto end = std::chrono::steady_clock::now();
+
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        csv_file << "ecdh_keygen," << i << "," << duration.count() << "\n";
+    }
+
     csv_file.close();
-    std::cout << "Benchmarks completed. Results saved to latencies.csv" << std::endl;
+    std::cout << "Benchmarks completed. Results saved to " << LATENCIES_CSV << std::endl;
 
     // Read back the CSV file and calculate statistics
-    std::cout << "\nCalculating statistics from latencies.csv..." << std::endl;
-    auto primitive_latencies = EPOS::S::read_latencies_csv("latencies.csv");
+    std::cout << "\nCalculating statistics from " << LATENCIES_CSV << "..." << std::endl;
+    auto primitive_latencies = EPOS::S::read_latencies_csv(LATENCIES_CSV);
     
     // Calculate and print statistics for each primitive
     for (const auto& pair : primitive_latencies) {
@@ -209,19 +585,95 @@ int main() {
         EPOS::S::print_throughput(poly1305_throughput);
     }
 
-    // AES encryption throughput (processes MAX_AES_MESSAGE_SIZE bytes per iteration)
+    // AES encryption throughput (processes a single KEY_SIZE block per iteration)
     if (primitive_latencies.find("aes128_enc") != primitive_latencies.end()) {
         EPOS::S::PrimitiveStats aes_enc_stats = EPOS::S::calculate_stats("aes128_enc", primitive_latencies.at("aes128_enc"));
-        EPOS::S::ThroughputStats aes_enc_throughput = EPOS::S::calculate_throughput(aes_enc_stats, MAX_AES_MESSAGE_SIZE);
+        EPOS::S::ThroughputStats aes_enc_throughput = EPOS::S::calculate_throughput(aes_enc_stats, EPOS::S::Cipher::KEY_SIZE);
         EPOS::S::print_throughput(aes_enc_throughput);
     }
 
-    // AES decryption throughput (processes MAX_AES_MESSAGE_SIZE bytes per iteration)
+    // AES decryption throughput (processes a single KEY_SIZE block per iteration)
     if (primitive_latencies.find("aes128_dec") != primitive_latencies.end()) {
         EPOS::S::PrimitiveStats aes_dec_stats = EPOS::S::calculate_stats("aes128_dec", primitive_latencies.at("aes128_dec"));
-        EPOS::S::ThroughputStats aes_dec_throughput = EPOS::S::calculate_throughput(aes_dec_stats, MAX_AES_MESSAGE_SIZE);
+        EPOS::S::ThroughputStats aes_dec_throughput = EPOS::S::calculate_throughput(aes_dec_stats, EPOS::S::Cipher::KEY_SIZE);
         EPOS::S::print_throughput(aes_dec_throughput);
     }
 
+    // AES bulk mode throughput (processes MAX_AES_MESSAGE_SIZE bytes per iteration)
+    for (const char* primitive : {"aes128_ecb", "aes128_cbc_enc", "aes128_cbc_dec", "aes128_ctr"}) {
+        if (primitive_latencies.find(primitive) == primitive_latencies.end())
+            continue;
+        EPOS::S::PrimitiveStats stats = EPOS::S::calculate_stats(primitive, primitive_latencies.at(primitive));
+        EPOS::S::print_throughput(EPOS::S::calculate_throughput(stats, MAX_AES_MESSAGE_SIZE));
+    }
+
+    // Compare against the last run of the other build configuration, if any (make benchmark benchmark_debug)
+    if (std::ifstream(OTHER_LATENCIES_CSV).good()) {
+        auto other_latencies = EPOS::S::read_latencies_csv(OTHER_LATENCIES_CSV);
+        std::cout << "\nComparing against " << OTHER_CONFIGURATION << " build results from " << OTHER_LATENCIES_CSV << "..." << std::endl;
+        for (const char* primitive : {"ecdh_shared", "ecdh_keygen", "poly1305"}) {
+            if (primitive_latencies.find(primitive) == primitive_latencies.end() || other_latencies.find(primitive) == other_latencies.end())
+                continue;
+            EPOS::S::PrimitiveStats stats = EPOS::S::calculate_stats(primitive, primitive_latencies.at(primitive));
+            EPOS::S::PrimitiveStats other_stats = EPOS::S::calculate_stats(primitive, other_latencies.at(primitive));
+            EPOS::S::print_delta(stats, other_stats, OTHER_CONFIGURATION);
+        }
+    }
+
+    // AES round implementations side by side
+    const char * aes_rows[] = {"aes128_enc", "aes128_dec"};
+    for (const char * row : aes_rows) {
+        std::string byte_row = std::string(row) + "_byte", t_table_row = std::string(row) + "_t_table";
+        if (primitive_latencies.find(byte_row) == primitive_latencies.end() || primitive_latencies.find(t_table_row) == primitive_latencies.end())
+            continue;
+        EPOS::S::PrimitiveStats byte_stats = EPOS::S::calculate_stats(byte_row, primitive_latencies.at(byte_row));
+        EPOS::S::PrimitiveStats t_table_stats = EPOS::S::calculate_stats(t_table_row, primitive_latencies.at(t_table_row));
+        EPOS::S::print_delta(t_table_stats, byte_stats, "byte-oriented");
+    }
+
+    // In-tree SHA-256 against CryptoPP, and multi-buffer against one message per call
+    if (primitive_latencies.find("sha256") != primitive_latencies.end() && primitive_latencies.find("sha256_epos") != primitive_latencies.end()) {
+        EPOS::S::PrimitiveStats cryptopp_stats = EPOS::S::calculate_stats("sha256", primitive_latencies.at("sha256"));
+        EPOS::S::PrimitiveStats epos_stats = EPOS::S::calculate_stats("sha256_epos", primitive_latencies.at("sha256_epos"));
+        EPOS::S::print_delta(epos_stats, cryptopp_stats, "CryptoPP");
+        if (primitive_latencies.find("sha256_batch") != primitive_latencies.end()) {
+            EPOS::S::PrimitiveStats batch_stats = EPOS::S::calculate_stats("sha256_batch", primitive_latencies.at("sha256_batch"));
+            EPOS::S::print_delta(batch_stats, epos_stats, "one message per call");
+        }
+    }
+
+    // Secured frames: single-pass CCM* against AES plus Poly1305 (FRAME_PAYLOAD_SIZE bytes per frame)
+    if (primitive_latencies.find("frame_ccm_enc") != primitive_latencies.end() && primitive_latencies.find("frame_aes_poly1305") != primitive_latencies.end()) {
+        EPOS::S::PrimitiveStats ccm_stats = EPOS::S::calculate_stats("frame_ccm_enc", primitive_latencies.at("frame_ccm_enc"));
+        EPOS::S::PrimitiveStats separate_stats = EPOS::S::calculate_stats("frame_aes_poly1305", primitive_latencies.at("frame_aes_poly1305"));
+        EPOS::S::print_throughput(EPOS::S::calculate_throughput(ccm_stats, FRAME_PAYLOAD_SIZE));
+        EPOS::S::print_throughput(EPOS::S::calculate_throughput(separate_stats, FRAME_PAYLOAD_SIZE));
+        EPOS::S::print_delta(ccm_stats, separate_stats, "AES + Poly1305");
+    }
+
+    // Cached security association lookup against a fresh ECDH and session key derivation
+    if (primitive_latencies.find("sa_lookup") != primitive_latencies.end() && primitive_latencies.find("sa_establish") != primitive_latencies.end()) {
+        EPOS::S::PrimitiveStats lookup_stats = EPOS::S::calculate_stats("sa_lookup", primitive_latencies.at("sa_lookup"));
+        EPOS::S::PrimitiveStats establish_stats = EPOS::S::calculate_stats("sa_establish", primitive_latencies.at("sa_establish"));
+        EPOS::S::print_delta(lookup_stats, establish_stats, "fresh ECDH + session keys");
+    }
+
+    // Poly1305 verify latency against the position of the first differing tag byte (flat if verify is constant time)
+    if (primitive_latencies.find("poly1305_verify") != primitive_latencies.end()) {
+        EPOS::S::PrimitiveStats match = EPOS::S::calculate_stats("poly1305_verify", primitive_latencies.at("poly1305_verify"));
+        double lowest = match.median_ns, highest = match.median_ns;
+        std::cout << "\nPoly1305 verify median latency: match " << match.median_ns << " ns, differing byte";
+        for (int position = 0; position < 16; ++position) {
+            std::string primitive = "poly1305_verify_diff" + std::to_string(position);
+            if (primitive_latencies.find(primitive) == primitive_latencies.end())
+                continue;
+            EPOS::S::PrimitiveStats stats = EPOS::S::calculate_stats(primitive, primitive_latencies.at(primitive));
+            std::cout << " " << position << ":" << stats.median_ns;
+            lowest = std::min(lowest, stats.median_ns);
+            highest = std::max(highest, stats.median_ns);
+        }
+        std::cout << std::endl << "Poly1305 verify median spread: " << highest - lowest << " ns" << std::endl;
+    }
+
     return 0;
 }
\ No newline at end of file
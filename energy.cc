@@ -5,6 +5,7 @@
 #include "EPOS/diffie_hellman.h"
 #include "EPOS/poly1305.h"
 #include "EPOS/cipher.h"
+#include "EPOS/random.h"
 #include "EPOS/benchmark_stats.h"
 
 #define ITERATIONS 10000
@@ -37,10 +38,7 @@ AES_Data aes_test_data[ITERATIONS];
 SHA256_Data sha256_test_data[ITERATIONS];
 
 void fill_random(void* buffer, size_t size) {
-    unsigned char* buf = static_cast<unsigned char*>(buffer);
-    for (size_t i = 0; i < size; ++i) {
-        buf[i] = static_cast<unsigned char>(rand() % 256);
-    }
+    EPOS::S::Random::fill(buffer, size);
 }
 
 int main(int argc, char* argv[]) {
@@ -0,0 +1,171 @@
+// Self-checks of the EPOS primitives against reference results (make check runs them)
+// Prints each failed check and exits with a non-zero status if any failed
+
+#include <iostream>
+#include "EPOS/bignum.h"
+#include "EPOS/diffie_hellman.h"
+#include "EPOS/random.h"
+
+#define REDUCTION_PRODUCTS 100000 // Random products per Bignum size and limb width
+
+// Bignum exposing both reductions of a double-width product: pseudo_mersenne_reduction(), selected by
+// Bignum_Reduction for SIZE 16 (secp128r1) and 17 (Poly1305), and the generic barrett_reduction()
+template<unsigned int SIZE, typename Limb>
+class Reduction_Check: public EPOS::S::Bignum<SIZE, Limb>
+{
+    typedef EPOS::S::Bignum<SIZE, Limb> Base;
+    typedef typename Base::Digit Digit;
+    using Base::DIGITS;
+    using Base::_mod;
+
+public:
+    // Number of products (random ones and products of edge-case operands) the two reductions disagree on
+    static unsigned int run(const char * name, unsigned int k) {
+        static const unsigned int EDGES = 9;
+        Digit edges[EDGES][DIGITS] = {};
+        edges[1][0] = 1;
+        edges[2][0] = 2;
+        for(unsigned int i = 0; i < DIGITS; i++) {
+            edges[3][i] = _mod.data[i]; // p
+            edges[4][i] = _mod.data[i]; // p - 1
+            edges[5][i] = _mod.data[i]; // p + 1
+            edges[6][i] = ~Digit(0); // 2^k - 1
+        }
+        Base::simple_sub(edges[4], edges[4], edges[1], DIGITS);
+        Base::simple_add(edges[5], edges[5], edges[1], DIGITS);
+        mask(edges[6], k);
+        edges[7][(k - 1) / Base::BITS_PER_DIGIT] = Digit(1) << ((k - 1) % Base::BITS_PER_DIGIT); // 2^(k - 1)
+        for(unsigned int i = 0; i < DIGITS; i++) // (p + 1) / 2
+            edges[8][i] = (edges[5][i] >> 1) | ((i + 1 < DIGITS) ? (edges[5][i + 1] << (Base::BITS_PER_DIGIT - 1)) : 0);
+
+        unsigned int mismatches = 0;
+        for(unsigned int i = 0; i < EDGES; i++)
+            for(unsigned int j = 0; j < EDGES; j++)
+                mismatches += !agree(edges[i], edges[j]);
+
+        for(unsigned int n = 0; n < REDUCTION_PRODUCTS; n++) {
+            Digit a[DIGITS], b[DIGITS];
+            EPOS::S::Random::fill(a, sizeof(a));
+            EPOS::S::Random::fill(b, sizeof(b));
+            mask(a, k);
+            mask(b, k);
+            mismatches += !agree(a, b);
+        }
+
+        std::cout << name << ": " << REDUCTION_PRODUCTS + EDGES * EDGES << " products, " << mismatches << " mismatches" << std::endl;
+        return mismatches;
+    }
+
+private:
+    // Keeps the k least significant bits of a, so that operands go up to 2^k - 1 (more than the modulus)
+    static void mask(Digit * a, unsigned int k) {
+        for(unsigned int i = 0; i < DIGITS; i++) {
+            if(k <= i * Base::BITS_PER_DIGIT)
+                a[i] = 0;
+            else if(k < (i + 1) * Base::BITS_PER_DIGIT)
+                a[i] &= (Digit(1) << (k % Base::BITS_PER_DIGIT)) - 1;
+        }
+    }
+
+    static bool agree(const Digit * a, const Digit * b) {
+        Digit product[2 * DIGITS];
+        Base::simple_mult(product, a, b, DIGITS);
+
+        Reduction_Check fold;
+        EPOS::S::U::Bignum_Reduction<SIZE>::reduce(static_cast<Base &>(fold), product);
+
+        Reduction_Check barrett;
+        barrett.barrett_reduction(barrett._data, product, DIGITS);
+
+        return Base::cmp(fold._data, barrett._data, DIGITS) == 0;
+    }
+};
+
+// secp128r1 shared keys (x ^ y of k * P), computed with an independent affine implementation of the curve
+// All byte strings are little-endian, as Bignum(bytes, len) reads them
+struct ECDH_Vector
+{
+    const char * name;
+    unsigned char x[16];
+    unsigned char y[16];
+    unsigned char k[16];
+    unsigned char shared[16];
+};
+
+#define SECP128R1_G_X { 0x86, 0x5b, 0x2c, 0xa5, 0x7c, 0x60, 0x28, 0x0c, 0x2d, 0x9b, 0x89, 0x8b, 0x52, 0xf7, 0x1f, 0x16 }
+#define SECP128R1_G_Y { 0x83, 0x7a, 0xed, 0xdd, 0x92, 0xa2, 0x2d, 0xc0, 0x13, 0xeb, 0xaf, 0x5b, 0x39, 0xc8, 0x5a, 0xcf }
+#define X_ZERO_X { 0 }
+#define X_ZERO_Y { 0x77, 0x74, 0x48, 0xdf, 0xef, 0xf3, 0x6d, 0x34, 0xa9, 0xe3, 0x69, 0x39, 0xc3, 0x6b, 0x72, 0x00 }
+#define K_RANDOM { 0x01, 0x18, 0xa1, 0x9a, 0x7c, 0xdb, 0x48, 0xd7, 0x95, 0x8a, 0x6a, 0xf0, 0x84, 0x98, 0xa0, 0xed }
+#define K_TWO { 0x02 }
+#define K_ORDER_MINUS_ONE { 0x14, 0xa1, 0x38, 0x90, 0x1b, 0x0d, 0xa3, 0x75, 0x00, 0x00, 0x00, 0x00, 0xfd, 0xff, 0xff, 0xff }
+
+static const ECDH_Vector ecdh_vectors[] = {
+    { "G, random k", SECP128R1_G_X, SECP128R1_G_Y, K_RANDOM,
+      { 0x11, 0x37, 0x93, 0xe3, 0x2a, 0xdc, 0x51, 0x39, 0x5d, 0xbc, 0x38, 0xbf, 0x4c, 0xf4, 0xd4, 0xcb } },
+    { "G, k = 2", SECP128R1_G_X, SECP128R1_G_Y, K_TWO,
+      { 0xeb, 0xd7, 0x08, 0xc0, 0xe2, 0x2d, 0x1e, 0x9a, 0x75, 0xbb, 0x74, 0x2d, 0x93, 0xf3, 0x89, 0x82 } },
+    { "G, k = n - 1", SECP128R1_G_X, SECP128R1_G_Y, K_ORDER_MINUS_ONE,
+      { 0x21, 0xca, 0x75, 0xdf, 0xb1, 0x58, 0xb8, 0x7f, 0x67, 0xce, 0x7c, 0x17, 0x18, 0xaa, 0x52, 0xea } },
+    // A peer key with x = 0 once made the co-Z ladder return an all-zero shared key
+    { "x = 0, random k", X_ZERO_X, X_ZERO_Y, K_RANDOM,
+      { 0x3e, 0x27, 0xce, 0xa2, 0xbf, 0x75, 0x5b, 0xc4, 0xb6, 0xfd, 0x88, 0x79, 0xd5, 0x51, 0xc3, 0x18 } },
+    { "x = 0, k = 2", X_ZERO_X, X_ZERO_Y, K_TWO,
+      { 0x09, 0xd0, 0x94, 0x9e, 0x27, 0xdd, 0x59, 0x6d, 0x4a, 0x5b, 0x3b, 0x55, 0x80, 0xa5, 0xb1, 0x28 } },
+    { "x = 0, k = n - 1", X_ZERO_X, X_ZERO_Y, K_ORDER_MINUS_ONE,
+      { 0x8c, 0x3b, 0x25, 0xe0, 0xd4, 0x7e, 0xa2, 0xbe, 0xac, 0x46, 0x00, 0x05, 0x5c, 0x1c, 0x9a, 0x86 } },
+};
+
+// Runs each vector through Diffie_Hellman::shared_key() and the batch shared_keys(), with the configured
+// Traits<Diffie_Hellman>::FIELD and MULTIPLICATION
+static unsigned int check_ecdh() {
+    typedef EPOS::S::Diffie_Hellman Diffie_Hellman;
+    static const unsigned int VECTORS = sizeof(ecdh_vectors) / sizeof(ECDH_Vector);
+
+    Diffie_Hellman::Public_Key points[VECTORS];
+    Diffie_Hellman::Private_Key keys[VECTORS];
+    Diffie_Hellman::Shared_Key expected[VECTORS], batch[VECTORS];
+    unsigned int failures = 0;
+
+    for(unsigned int i = 0; i < VECTORS; i++) {
+        const ECDH_Vector & v = ecdh_vectors[i];
+        points[i] = Diffie_Hellman::Public_Key(Diffie_Hellman::Shared_Key(v.x, 16), Diffie_Hellman::Shared_Key(v.y, 16));
+        keys[i] = Diffie_Hellman::Private_Key(v.k, 16);
+        expected[i] = Diffie_Hellman::Shared_Key(v.shared, 16);
+
+        if(!Diffie_Hellman::is_valid_point(points[i])) {
+            std::cerr << "ECDH vector \"" << v.name << "\": point rejected" << std::endl;
+            failures++;
+        }
+        if(Diffie_Hellman::shared_key(points[i], keys[i]) != expected[i]) {
+            std::cerr << "ECDH vector \"" << v.name << "\": wrong shared_key()" << std::endl;
+            failures++;
+        }
+    }
+
+    Diffie_Hellman::shared_keys(points, keys, batch, VECTORS);
+    for(unsigned int i = 0; i < VECTORS; i++)
+        if(batch[i] != expected[i]) {
+            std::cerr << "ECDH vector \"" << ecdh_vectors[i].name << "\": wrong shared_keys()" << std::endl;
+            failures++;
+        }
+
+    std::cout << "ECDH shared keys: " << VECTORS << " vectors, " << failures << " failures" << std::endl;
+    return failures;
+}
+
+int main() {
+    unsigned int failures = 0;
+
+    failures += Reduction_Check<16, EPOS::S::U::Bignum_Limb<32>>::run("secp128r1 reduction, 32-bit limbs", 128);
+    failures += Reduction_Check<17, EPOS::S::U::Bignum_Limb<32>>::run("Poly1305 reduction, 32-bit limbs", 130);
+#ifdef __SIZEOF_INT128__
+    failures += Reduction_Check<16, EPOS::S::U::Bignum_Limb<64>>::run("secp128r1 reduction, 64-bit limbs", 128);
+    failures += Reduction_Check<17, EPOS::S::U::Bignum_Limb<64>>::run("Poly1305 reduction, 64-bit limbs", 130);
+#endif
+    failures += check_ecdh();
+
+    if(failures)
+        std::cerr << failures << " checks failed" << std::endl;
+    return failures != 0;
+}